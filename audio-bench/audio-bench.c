@@ -0,0 +1,688 @@
+/* Microbenchmarks for the audio hot paths of sdl2-loadwav and sdl2-mixer.
+ *
+ * Every input is synthesized at startup from a fixed seed, so two runs on
+ * the same machine measure the same work:
+ *
+ *   decode/...   SDL_LoadWAV_RW from memory: 16 bit PCM, 32 bit float, IMA
+ *                ADPCM and MS ADPCM versions of one stereo clip
+ *   parse/...    wav_map() on the PCM clip written to a temporary file
+ *   callback/... the sdl2-loadwav callback copy and the multi-voice mixer
+ *   convert/...  sample format kernels and the resampler
+ *   postmix/...  the sdl2-mixer postmix copy into the ring and the waveform
+ *                decimation kernels
+ *
+ * Each benchmark runs WARMUP_REPS untimed repetitions, then --reps timed
+ * ones of at least REP_SECONDS each; the result is nanoseconds per sample
+ * (one channel of one frame), median, min and max over the repetitions.
+ * --json prints the same results in a stable order for diffing.
+ *
+ * usage: audio-bench [--json] [--reps n] [name filter]
+ */
+#include <SDL2/SDL.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "convert.h"
+#include "decimate.h"
+#include "mixer.h"
+#include "ring.h"
+#include "wav.h"
+
+#define RATE 44100
+#define CHANNELS 2
+#define CLIP_FRAMES RATE /* one second */
+#define CLIP_SAMPLES (CLIP_FRAMES * CHANNELS)
+
+#define CALLBACK_FRAMES 1024 /* what a device typically asks for */
+#define MIX_VOICES 8
+#define POSTMIX_FRAMES 4096
+#define COLUMNS 640
+
+#define IMA_BLOCK_ALIGN 2048
+#define MS_BLOCK_ALIGN 2048
+
+#define WARMUP_REPS 2
+#define DEFAULT_REPS 7
+#define MAX_REPS 101
+/* minimum time spent in one repetition */
+#define REP_SECONDS 0.05
+
+struct wav_file
+{
+    Uint8 *data;
+    size_t len;
+};
+
+/* synthetic inputs, built once */
+static Sint16 clip[CLIP_SAMPLES];
+static float clip_f32[CLIP_SAMPLES];
+static struct wav_file wav_pcm16, wav_f32, wav_ima, wav_ms;
+static char wav_path[64];
+
+/* scratch */
+static Sint16 out_s16[CLIP_SAMPLES * 2];
+static float out_f32[CLIP_SAMPLES];
+static Uint8 *resampled;
+static struct converter resamplers[CONVERT_QUALITIES];
+static struct envelope env[COLUMNS];
+static struct ring ring;
+static struct bank mix_bank;
+
+/******************************************************************************/
+/* input synthesis                                                            */
+
+/* two sines per channel plus a little noise, about -6 dBFS */
+static void make_clip(void)
+{
+    Uint32 seed = 1;
+
+    for (int i = 0; i < CLIP_FRAMES; i++)
+    {
+        for (int c = 0; c < CHANNELS; c++)
+        {
+            seed = seed * 1103515245 + 12345;
+            const double t = (double)i / RATE;
+            const double x = 0.3 * sin(2 * M_PI * (220.0 + 110.0 * c) * t) +
+                             0.15 * sin(2 * M_PI * 3520.0 * t) +
+                             0.02 * ((Sint16)(seed >> 16) / 32768.0);
+            clip[i * CHANNELS + c] = (Sint16)lrint(x * 32767.0);
+            clip_f32[i * CHANNELS + c] = (float)x;
+        }
+    }
+}
+
+static Uint8 *put16(Uint8 *p, Uint16 v)
+{
+    p[0] = v & 0xff;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static Uint8 *put32(Uint8 *p, Uint32 v)
+{
+    p = put16(p, v & 0xffff);
+    return put16(p, v >> 16);
+}
+
+/* RIFF/WAVE around data; extra is appended to the fmt chunk after cbSize */
+static struct wav_file make_wav(Uint16 tag, Uint16 bits, Uint16 block_align, Uint32 block_frames,
+                                const Uint8 *extra, Uint16 extra_len, Uint32 frames, const void *data,
+                                Uint32 data_len)
+{
+    const Uint32 fmt_len = 18 + extra_len;
+    const int fact = (tag != 1 && tag != 3);
+    struct wav_file w;
+
+    w.len = 12 + 8 + fmt_len + (fact ? 12 : 0) + 8 + data_len;
+    w.data = SDL_malloc(w.len);
+    if (w.data == NULL)
+    {
+        return w;
+    }
+
+    Uint8 *p = w.data;
+    memcpy(p, "RIFF", 4);
+    p = put32(p + 4, (Uint32)w.len - 8);
+    memcpy(p, "WAVEfmt ", 8);
+    p = put32(p + 8, fmt_len);
+    p = put16(p, tag);
+    p = put16(p, CHANNELS);
+    p = put32(p, RATE);
+    p = put32(p, (Uint32)((Uint64)RATE * block_align / block_frames));
+    p = put16(p, block_align);
+    p = put16(p, bits);
+    p = put16(p, extra_len);
+    memcpy(p, extra, extra_len);
+    p += extra_len;
+    if (fact)
+    {
+        memcpy(p, "fact", 4);
+        p = put32(p + 4, 4);
+        p = put32(p, frames);
+    }
+    memcpy(p, "data", 4);
+    p = put32(p + 4, data_len);
+    memcpy(p, data, data_len);
+    return w;
+}
+
+static const int ima_steps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66,
+    73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408,
+    449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630,
+    9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767};
+static const int ima_index[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+struct ima_state
+{
+    int sample;
+    int index;
+};
+
+static int ima_encode(struct ima_state *s, int x)
+{
+    const int step = ima_steps[s->index];
+    int diff = x - s->sample, nibble = 0, delta = step >> 3;
+
+    if (diff < 0)
+    {
+        nibble = 8;
+        diff = -diff;
+    }
+    for (int bit = 4; bit > 0; bit >>= 1)
+    {
+        if (diff >= step * bit / 4)
+        {
+            nibble |= bit;
+            diff -= step * bit / 4;
+            delta += step * bit / 4;
+        }
+    }
+    s->sample += (nibble & 8) ? -delta : delta;
+    s->sample = SDL_max(-32768, SDL_min(32767, s->sample));
+    s->index = SDL_max(0, SDL_min(88, s->index + ima_index[nibble]));
+    return nibble;
+}
+
+/* IMA ADPCM: per block a 4 byte header per channel, then 8 samples per channel in turn */
+static struct wav_file make_ima(void)
+{
+    const int per_block = (IMA_BLOCK_ALIGN - 4 * CHANNELS) * 8 / (4 * CHANNELS) + 1;
+    const int blocks = (CLIP_FRAMES + per_block - 1) / per_block;
+    Uint8 *data = SDL_calloc(blocks, IMA_BLOCK_ALIGN);
+    struct ima_state state[CHANNELS] = {{0, 0}};
+    Uint8 extra[2];
+    struct wav_file w = {NULL, 0};
+
+    if (data == NULL)
+    {
+        return w;
+    }
+    for (int b = 0; b < blocks; b++)
+    {
+        Uint8 *p = data + (size_t)b * IMA_BLOCK_ALIGN;
+        const int first = b * per_block;
+        for (int c = 0; c < CHANNELS; c++)
+        {
+            state[c].sample = clip[SDL_min(first, CLIP_FRAMES - 1) * CHANNELS + c];
+            p = put16(p, (Uint16)state[c].sample);
+            *p++ = state[c].index;
+            *p++ = 0;
+        }
+        for (int i = 1; i < per_block; i += 8)
+        {
+            for (int c = 0; c < CHANNELS; c++)
+            {
+                for (int k = 0; k < 8; k += 2)
+                {
+                    const int f0 = SDL_min(first + i + k, CLIP_FRAMES - 1);
+                    const int f1 = SDL_min(first + i + k + 1, CLIP_FRAMES - 1);
+                    const int lo = ima_encode(&state[c], clip[f0 * CHANNELS + c]);
+                    const int hi = ima_encode(&state[c], clip[f1 * CHANNELS + c]);
+                    *p++ = lo | (hi << 4);
+                }
+            }
+        }
+    }
+    put16(extra, per_block);
+    w = make_wav(0x11, 4, IMA_BLOCK_ALIGN, per_block, extra, sizeof(extra), CLIP_FRAMES, data, blocks * IMA_BLOCK_ALIGN);
+    SDL_free(data);
+    return w;
+}
+
+static const int ms_coef[7][2] = {{256, 0}, {512, -256}, {0, 0}, {192, 64}, {240, 0}, {460, -208}, {392, -232}};
+static const int ms_adapt[16] = {230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230};
+
+struct ms_state
+{
+    int s1, s2; /* the last two decoded samples, s1 the newest */
+    int delta;
+};
+
+static int ms_encode(struct ms_state *s, int x)
+{
+    const int pred = (s->s1 * ms_coef[1][0] + s->s2 * ms_coef[1][1]) / 256;
+    int nibble = (int)lrint((double)(x - pred) / s->delta);
+    nibble = SDL_max(-8, SDL_min(7, nibble));
+
+    const int y = SDL_max(-32768, SDL_min(32767, pred + nibble * s->delta));
+    s->s2 = s->s1;
+    s->s1 = y;
+    s->delta = SDL_max(16, ms_adapt[nibble & 15] * s->delta / 256);
+    return nibble & 15;
+}
+
+/* MS ADPCM with predictor 1 everywhere: a 7 byte header per channel, then nibbles interleaved by channel */
+static struct wav_file make_ms(void)
+{
+    const int per_block = (MS_BLOCK_ALIGN - 7 * CHANNELS) * 2 / CHANNELS + 2;
+    const int blocks = (CLIP_FRAMES + per_block - 1) / per_block;
+    Uint8 *data = SDL_calloc(blocks, MS_BLOCK_ALIGN);
+    struct ms_state state[CHANNELS];
+    Uint8 extra[4 + 7 * 4];
+    struct wav_file w = {NULL, 0};
+
+    if (data == NULL)
+    {
+        return w;
+    }
+    for (int b = 0; b < blocks; b++)
+    {
+        Uint8 *p = data + (size_t)b * MS_BLOCK_ALIGN;
+        const int first = b * per_block;
+        for (int c = 0; c < CHANNELS; c++)
+        {
+            // the header holds the first two samples verbatim, the second one as s1
+            state[c].s2 = clip[SDL_min(first, CLIP_FRAMES - 1) * CHANNELS + c];
+            state[c].s1 = clip[SDL_min(first + 1, CLIP_FRAMES - 1) * CHANNELS + c];
+            state[c].delta = 16;
+            *p++ = 1;
+        }
+        for (int c = 0; c < CHANNELS; c++)
+        {
+            p = put16(p, (Uint16)state[c].delta);
+        }
+        for (int c = 0; c < CHANNELS; c++)
+        {
+            p = put16(p, (Uint16)state[c].s1);
+        }
+        for (int c = 0; c < CHANNELS; c++)
+        {
+            p = put16(p, (Uint16)state[c].s2);
+        }
+        int hi = 1;
+        for (int i = 2; i < per_block; i++)
+        {
+            for (int c = 0; c < CHANNELS; c++)
+            {
+                const int f = SDL_min(first + i, CLIP_FRAMES - 1);
+                const int nibble = ms_encode(&state[c], clip[f * CHANNELS + c]);
+                if (hi)
+                {
+                    *p = nibble << 4;
+                }
+                else
+                {
+                    *p++ |= nibble;
+                }
+                hi = !hi;
+            }
+        }
+    }
+
+    Uint8 *p = put16(extra, per_block);
+    p = put16(p, 7);
+    for (int i = 0; i < 7; i++)
+    {
+        p = put16(p, (Uint16)ms_coef[i][0]);
+        p = put16(p, (Uint16)ms_coef[i][1]);
+    }
+    w = make_wav(0x02, 4, MS_BLOCK_ALIGN, per_block, extra, sizeof(extra), CLIP_FRAMES, data, blocks * MS_BLOCK_ALIGN);
+    SDL_free(data);
+    return w;
+}
+
+static int make_inputs(void)
+{
+    make_clip();
+    wav_pcm16 = make_wav(1, 16, CHANNELS * 2, 1, NULL, 0, CLIP_FRAMES, clip, sizeof(clip));
+    wav_f32 = make_wav(3, 32, CHANNELS * 4, 1, NULL, 0, CLIP_FRAMES, clip_f32, sizeof(clip_f32));
+    wav_ima = make_ima();
+    wav_ms = make_ms();
+    if (!wav_pcm16.data || !wav_f32.data || !wav_ima.data || !wav_ms.data)
+    {
+        return SDL_SetError("out of memory");
+    }
+
+    snprintf(wav_path, sizeof(wav_path), "/tmp/audio-bench-%d.wav", (int)getpid());
+    FILE *f = fopen(wav_path, "wb");
+    if (f == NULL || fwrite(wav_pcm16.data, 1, wav_pcm16.len, f) != wav_pcm16.len)
+    {
+        if (f != NULL)
+        {
+            fclose(f);
+        }
+        return SDL_SetError("cannot write %s", wav_path);
+    }
+    fclose(f);
+
+    if (ring_init(&ring, 8, POSTMIX_FRAMES * CHANNELS) < 0)
+    {
+        return -1;
+    }
+
+    // the mixer plays one bank entry: the whole clip
+    static struct bank_entry entry = {0, CLIP_FRAMES, 0};
+    mix_bank.freq = RATE;
+    mix_bank.channels = CHANNELS;
+    mix_bank.arena = clip;
+    mix_bank.arena_len = CLIP_SAMPLES;
+    mix_bank.index = &entry;
+    mix_bank.count = 1;
+    mix_bank.names = "clip";
+    return 0;
+}
+
+/******************************************************************************/
+/* benchmarks                                                                 */
+
+static void decode(const struct wav_file *w)
+{
+    SDL_AudioSpec spec;
+    Uint8 *buf;
+    Uint32 len;
+
+    if (SDL_LoadWAV_RW(SDL_RWFromConstMem(w->data, (int)w->len), 1, &spec, &buf, &len) == NULL)
+    {
+        fprintf(stderr, "decode: %s\n", SDL_GetError());
+        exit(1);
+    }
+    SDL_FreeWAV(buf);
+}
+
+static void bench_decode_pcm16(const void *arg)
+{
+    decode(&wav_pcm16);
+}
+
+static void bench_decode_f32(const void *arg)
+{
+    decode(&wav_f32);
+}
+
+static void bench_decode_ima(const void *arg)
+{
+    decode(&wav_ima);
+}
+
+static void bench_decode_ms(const void *arg)
+{
+    decode(&wav_ms);
+}
+
+static void bench_parse(const void *arg)
+{
+    struct wav_map wav;
+
+    if (wav_map(wav_path, &wav) < 0)
+    {
+        fprintf(stderr, "parse: %s\n", SDL_GetError());
+        exit(1);
+    }
+    wav_unmap(&wav);
+}
+
+/* sdl2-loadwav's callback: copy the next device buffer out of the loaded clip */
+static void bench_callback_copy(const void *arg)
+{
+    for (int i = 0; i < CLIP_SAMPLES; i += CALLBACK_FRAMES * CHANNELS)
+    {
+        const int n = SDL_min(CALLBACK_FRAMES * CHANNELS, CLIP_SAMPLES - i);
+        SDL_memcpy(out_s16, clip + i, n * sizeof(Sint16));
+    }
+}
+
+/* the mixer with MIX_VOICES voices of the clip, kernel forced to arg */
+static void bench_callback_mix(const void *arg)
+{
+    static struct mixer m;
+
+    mixer_init(&m, &mix_bank);
+    m.k = arg;
+    for (int v = 0; v < MIX_VOICES; v++)
+    {
+        mixer_trigger(&m, 0, MIXER_UNITY / MIX_VOICES);
+    }
+    // whole callbacks only, so every sample counted is one the voices play
+    for (int i = 0; i + CALLBACK_FRAMES * CHANNELS <= CLIP_SAMPLES; i += CALLBACK_FRAMES * CHANNELS)
+    {
+        mixer_mix(&m, out_s16, CALLBACK_FRAMES * CHANNELS);
+    }
+}
+
+static void bench_s16_to_f32(const void *arg)
+{
+    ((const struct convert_kernels *)arg)->s16_to_f32(clip, out_f32, CLIP_SAMPLES);
+}
+
+static void bench_f32_to_s16(const void *arg)
+{
+    ((const struct convert_kernels *)arg)->f32_to_s16(clip_f32, out_s16, CLIP_SAMPLES);
+}
+
+/* the whole clip, 44100 -> 48000, through converter arg; main() sets it up, so filter design is not timed */
+static void bench_resample(const void *arg)
+{
+    struct converter *cv = (struct converter *)arg;
+
+    converter_reset(cv);
+    size_t len = converter_process(cv, (const Uint8 *)clip, sizeof(clip), resampled);
+    converter_flush(cv, resampled + len);
+}
+
+/* sdl2-mixer's postmix: copy each mixer buffer into the ring, the consumer frees it */
+static void bench_postmix_ring(const void *arg)
+{
+    for (int i = 0; i + POSTMIX_FRAMES * CHANNELS <= CLIP_SAMPLES; i += POSTMIX_FRAMES * CHANNELS)
+    {
+        struct ring_block *block = ring_write_begin(&ring);
+        memcpy(block->data, clip + i, POSTMIX_FRAMES * CHANNELS * sizeof(Sint16));
+        block->len = POSTMIX_FRAMES * CHANNELS;
+        ring_write_commit(&ring);
+        ring_pop(&ring);
+    }
+}
+
+static void bench_decimate(const void *arg)
+{
+    const struct decimate_kernel *k = arg;
+
+    for (int i = 0; i + POSTMIX_FRAMES <= CLIP_FRAMES; i += POSTMIX_FRAMES)
+    {
+        k->fn(clip + i * CHANNELS, POSTMIX_FRAMES, COLUMNS, env);
+    }
+}
+
+/******************************************************************************/
+/* harness                                                                    */
+
+struct result
+{
+    char name[64];
+    Uint64 samples; /* per call */
+    double median, min, max;
+};
+
+static struct result results[64];
+static int nresults;
+
+static int compare_double(const void *a, const void *b)
+{
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const char *name, const char *filter, void (*fn)(const void *), const void *arg,
+                Uint64 samples, int reps)
+{
+    const double freq = (double)SDL_GetPerformanceFrequency();
+    double ns[MAX_REPS];
+
+    if (filter != NULL && strstr(name, filter) == NULL)
+    {
+        return;
+    }
+    if (nresults == (int)SDL_arraysize(results))
+    {
+        fprintf(stderr, "too many benchmarks, %s skipped\n", name);
+        return;
+    }
+
+    for (int r = -WARMUP_REPS; r < reps; r++)
+    {
+        Uint64 calls = 0;
+        const Uint64 start = SDL_GetPerformanceCounter();
+        Uint64 now;
+        do
+        {
+            fn(arg);
+            calls++;
+            now = SDL_GetPerformanceCounter();
+        } while ((now - start) / freq < REP_SECONDS);
+
+        if (r >= 0)
+        {
+            ns[r] = (now - start) / freq * 1e9 / ((double)calls * samples);
+        }
+    }
+    qsort(ns, reps, sizeof(double), compare_double);
+
+    struct result *res = &results[nresults++];
+    snprintf(res->name, sizeof(res->name), "%s", name);
+    res->samples = samples;
+    res->median = ns[reps / 2];
+    res->min = ns[0];
+    res->max = ns[reps - 1];
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = NULL;
+    int json = 0, reps = DEFAULT_REPS;
+    char name[64];
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--json"))
+        {
+            json = 1;
+        }
+        else if (!strcmp(argv[i], "--reps") && i + 1 < argc)
+        {
+            reps = atoi(argv[++i]);
+        }
+        else if (argv[i][0] != '-' && filter == NULL)
+        {
+            filter = argv[i];
+        }
+        else
+        {
+            reps = 0;
+        }
+    }
+    if (reps <= 0 || reps > MAX_REPS)
+    {
+        fprintf(stderr, "Usage: %s [--json] [--reps 1-%d] [name filter]\n", *argv, MAX_REPS);
+        return 1;
+    }
+
+    if (make_inputs() < 0)
+    {
+        fprintf(stderr, "%s\n", SDL_GetError());
+        return 1;
+    }
+    {
+        size_t len = 0;
+        for (int q = 0; q < CONVERT_QUALITIES; q++)
+        {
+            if (converter_init(&resamplers[q], AUDIO_S16LSB, CHANNELS, RATE, AUDIO_S16LSB, CHANNELS, 48000, q) < 0)
+            {
+                fprintf(stderr, "resample: %s\n", SDL_GetError());
+                return 1;
+            }
+            len = SDL_max(len, converter_max_output(&resamplers[q], sizeof(clip)));
+        }
+        resampled = SDL_malloc(len);
+        if (resampled == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+
+    run("decode/pcm16", filter, bench_decode_pcm16, NULL, CLIP_SAMPLES, reps);
+    run("decode/float32", filter, bench_decode_f32, NULL, CLIP_SAMPLES, reps);
+    run("decode/ima_adpcm", filter, bench_decode_ima, NULL, CLIP_SAMPLES, reps);
+    run("decode/ms_adpcm", filter, bench_decode_ms, NULL, CLIP_SAMPLES, reps);
+    run("parse/wav_map", filter, bench_parse, NULL, CLIP_SAMPLES, reps);
+    run("callback/copy", filter, bench_callback_copy, NULL, CLIP_SAMPLES, reps);
+
+    // SIMD paths: every kernel the CPU supports, so one run compares them;
+    // the mixer counts every sample of every voice it adds
+    for (int k = 0; k < mixer_kernel_count; k++)
+    {
+        if (mixer_kernels[k].supported == NULL || mixer_kernels[k].supported())
+        {
+            snprintf(name, sizeof(name), "callback/mix%d/%s", MIX_VOICES, mixer_kernels[k].name);
+            run(name, filter, bench_callback_mix, &mixer_kernels[k],
+                (Uint64)(CLIP_SAMPLES / (CALLBACK_FRAMES * CHANNELS) * CALLBACK_FRAMES * CHANNELS) * MIX_VOICES, reps);
+        }
+    }
+    for (int k = 0; k < convert_kernel_count; k++)
+    {
+        if (convert_kernels[k].supported == NULL || convert_kernels[k].supported())
+        {
+            snprintf(name, sizeof(name), "convert/s16_to_f32/%s", convert_kernels[k].name);
+            run(name, filter, bench_s16_to_f32, &convert_kernels[k], CLIP_SAMPLES, reps);
+            snprintf(name, sizeof(name), "convert/f32_to_s16/%s", convert_kernels[k].name);
+            run(name, filter, bench_f32_to_s16, &convert_kernels[k], CLIP_SAMPLES, reps);
+        }
+    }
+    static const enum convert_quality qualities[] = {CONVERT_FAST, CONVERT_MEDIUM, CONVERT_BEST};
+    for (int q = 0; q < (int)SDL_arraysize(qualities); q++)
+    {
+        snprintf(name, sizeof(name), "convert/resample_44100_48000/%s", convert_quality_names[qualities[q]]);
+        run(name, filter, bench_resample, &resamplers[qualities[q]], CLIP_SAMPLES, reps);
+    }
+    run("postmix/ring_copy", filter, bench_postmix_ring, NULL, CLIP_SAMPLES / (POSTMIX_FRAMES * CHANNELS) * POSTMIX_FRAMES * CHANNELS, reps);
+    for (int k = 0; k < DECIMATE_KERNELS; k++)
+    {
+        if (decimate_kernels[k].supported == NULL || decimate_kernels[k].supported())
+        {
+            snprintf(name, sizeof(name), "postmix/decimate/%s", decimate_kernels[k].name);
+            run(name, filter, bench_decimate, &decimate_kernels[k], CLIP_FRAMES / POSTMIX_FRAMES * POSTMIX_FRAMES * CHANNELS, reps);
+        }
+    }
+
+    SDL_version v;
+    SDL_GetVersion(&v);
+    if (json)
+    {
+        printf("{\"sdl\": \"%d.%d.%d\", \"reps\": %d, \"warmup\": %d, \"rep_seconds\": %.3f, \"results\": [\n",
+               v.major, v.minor, v.patch, reps, WARMUP_REPS, REP_SECONDS);
+        for (int i = 0; i < nresults; i++)
+        {
+            printf(" {\"name\": \"%s\", \"samples\": %llu, \"ns_per_sample\": "
+                   "{\"median\": %.4f, \"min\": %.4f, \"max\": %.4f}}%s\n",
+                   results[i].name, (unsigned long long)results[i].samples, results[i].median, results[i].min,
+                   results[i].max, i + 1 < nresults ? "," : "");
+        }
+        printf("]}\n");
+    }
+    else
+    {
+        printf("SDL %d.%d.%d, %d reps of >= %.0f ms after %d warmup\n", v.major, v.minor, v.patch, reps,
+               REP_SECONDS * 1000, WARMUP_REPS);
+        printf("%-36s %12s %12s %12s\n", "benchmark", "ns/sample", "min", "max");
+        for (int i = 0; i < nresults; i++)
+        {
+            printf("%-36s %12.4f %12.4f %12.4f\n", results[i].name, results[i].median, results[i].min,
+                   results[i].max);
+        }
+    }
+
+    unlink(wav_path);
+    ring_free(&ring);
+    SDL_free(resampled);
+    for (int q = 0; q < CONVERT_QUALITIES; q++)
+    {
+        converter_free(&resamplers[q]);
+    }
+    return 0;
+}
@@ -0,0 +1,182 @@
+/* Frame pacing for render loops.
+ *
+ * Call frame_pacer_wait() right after presenting a frame.  It measures the
+ * interval since the previous present and then, unless presenting already
+ * blocks on vsync, sleeps on CLOCK_MONOTONIC until the next deadline.
+ * Deadlines are absolute and advance by exactly one refresh period, so the
+ * time spent rendering is absorbed instead of added to the sleep, and
+ * rounding never accumulates.  A frame that overruns its deadline pushes the
+ * schedule forward by whole periods and counts as missed.
+ *
+ * Drivers sometimes grant a vsync request but return from present at once.
+ * Several presents in a row that come back in under half a period turn the
+ * vsync flag off, and the pacer sleeps itself from then on.
+ *
+ * Loops that present only when something changed (retained frames) have no
+ * steady interval to pace, and must not sleep after a present.  They ask
+ * frame_pacer_hold_ms() before presenting, which holds them to one present
+ * per period, and call frame_pacer_presented() after, with when the frame
+ * became due.  Nothing is slept and the gaps between presents are not timed;
+ * the statistics are how late each present came after it was both due and
+ * allowed instead, and one more than a period late counts as missed.
+ *
+ * No SDL calls are made here, so the SDL 1.2 and SDL 2 programs can share
+ * it: the caller passes the refresh rate from SDL_GetDisplayMode() or the
+ * framebuffer, and whether vsync is active.
+ */
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define FRAME_PACER_DEFAULT_HZ 60
+/* presents in a row this fast before vsync is assumed not to work */
+#define FRAME_PACER_VSYNC_CHECK 8
+
+struct frame_pacer
+{
+    int64_t period_ns;
+    int vsync;        /* present blocks until the vertical blank */
+    int vsync_broken; /* requested, but present did not block */
+    int fast_presents;
+    int retained; /* frame_pacer_presented() is in use */
+
+    int64_t deadline_ns; /* of the next present, when sleeping */
+    int64_t last_ns;     /* when the previous frame_pacer_wait() was called */
+    int64_t first_ns;    /* retained: of the first present */
+
+    /* intervals between presents; retained: how late each present was */
+    uint64_t frames;
+    uint64_t missed;
+    double sum_ms;
+    double deviation_ms; /* sum of |interval - period| */
+    double max_ms;
+};
+
+static inline int64_t frame_pacer_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* refresh_hz <= 0 means unknown and uses FRAME_PACER_DEFAULT_HZ */
+static inline void frame_pacer_init(struct frame_pacer *p, int refresh_hz, int vsync)
+{
+    *p = (struct frame_pacer){0};
+    p->period_ns = 1000000000 / (refresh_hz > 0 ? refresh_hz : FRAME_PACER_DEFAULT_HZ);
+    p->vsync = vsync;
+    p->last_ns = frame_pacer_now();
+    p->deadline_ns = p->last_ns + p->period_ns;
+}
+
+static inline void frame_pacer_sleep_until(int64_t deadline_ns)
+{
+    struct timespec ts;
+    ts.tv_sec = deadline_ns / 1000000000;
+    ts.tv_nsec = deadline_ns % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+static inline void frame_pacer_wait(struct frame_pacer *p)
+{
+    const int64_t now = frame_pacer_now();
+    const int64_t interval = now - p->last_ns;
+    const double interval_ms = interval / 1e6;
+    const double period_ms = p->period_ns / 1e6;
+
+    p->last_ns = now;
+    p->frames++;
+    p->sum_ms += interval_ms;
+    p->deviation_ms += interval_ms > period_ms ? interval_ms - period_ms : period_ms - interval_ms;
+    if (interval_ms > p->max_ms)
+    {
+        p->max_ms = interval_ms;
+    }
+    /* one and a half periods: the frame was shown at least one refresh late */
+    if (2 * interval > 3 * p->period_ns)
+    {
+        p->missed += (interval + p->period_ns / 2) / p->period_ns - 1;
+    }
+
+    if (p->vsync)
+    {
+        p->fast_presents = 2 * interval < p->period_ns ? p->fast_presents + 1 : 0;
+        if (p->fast_presents < FRAME_PACER_VSYNC_CHECK)
+        {
+            p->deadline_ns = now + p->period_ns;
+            return;
+        }
+        p->vsync = 0;
+        p->vsync_broken = 1;
+    }
+
+    if (p->deadline_ns <= now)
+    {
+        /* late: skip the slots that already passed rather than rushing to catch up */
+        p->deadline_ns += ((now - p->deadline_ns) / p->period_ns + 1) * p->period_ns;
+    }
+    frame_pacer_sleep_until(p->deadline_ns);
+    p->deadline_ns += p->period_ns;
+}
+
+/* retained: 0 when a present may go now, else the milliseconds until one may */
+static inline int frame_pacer_hold_ms(const struct frame_pacer *p)
+{
+    const int64_t now = frame_pacer_now();
+    return now >= p->deadline_ns ? 0 : (int)((p->deadline_ns - now + 999999) / 1000000);
+}
+
+/* retained: right after presenting a frame that could have gone on screen at due_ns, on frame_pacer_now()'s clock */
+static inline void frame_pacer_presented(struct frame_pacer *p, int64_t due_ns)
+{
+    const int64_t now = frame_pacer_now();
+    /* held back on purpose until the deadline is not late */
+    const int64_t allowed_ns = due_ns > p->deadline_ns ? due_ns : p->deadline_ns;
+    const int64_t late = now > allowed_ns ? now - allowed_ns : 0;
+
+    if (p->frames == 0)
+    {
+        p->first_ns = now;
+    }
+    p->retained = 1;
+    p->frames++;
+    p->sum_ms += late / 1e6;
+    if (late / 1e6 > p->max_ms)
+    {
+        p->max_ms = late / 1e6;
+    }
+    if (late > p->period_ns)
+    {
+        p->missed++;
+    }
+    p->last_ns = now;
+    p->deadline_ns = now + p->period_ns;
+}
+
+static inline void frame_pacer_report(const struct frame_pacer *p, FILE *f)
+{
+    if (p->frames == 0)
+    {
+        return;
+    }
+    if (p->retained)
+    {
+        const double seconds = (p->last_ns - p->first_ns) / 1e9;
+        fprintf(f, "presents: %llu in %.3f s, %.1f/s (at most %.1f/s); late avg %.3f ms, max %.3f ms; missed %llu\n",
+                (unsigned long long)p->frames, seconds, seconds > 0 ? (p->frames - 1) / seconds : 0.0,
+                1e9 / p->period_ns, p->sum_ms / p->frames, p->max_ms, (unsigned long long)p->missed);
+        return;
+    }
+    fprintf(f, "frames: %llu at %.3f ms (%s); interval avg %.3f ms, max %.3f ms, jitter %.3f ms; missed %llu\n",
+            (unsigned long long)p->frames, p->period_ns / 1e6,
+            p->vsync ? "vsync" : p->vsync_broken ? "vsync did not block, slept" : "slept",
+            p->sum_ms / p->frames, p->max_ms, p->deviation_ms / p->frames, (unsigned long long)p->missed);
+}
+
+#endif /* FRAME_PACER_H */
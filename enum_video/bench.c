@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "bench.h"
+#include "json.h"
+
+#define BENCH_MAX_DRIVERS 16
+#define BENCH_RECTS 64 // per fill, 64 x 64 each
+#define BENCH_SOURCE 256
+
+enum
+{
+    TEST_CLEAR,
+    TEST_FILL,
+    TEST_UPDATE,
+    TEST_LOCK,
+    TEST_COPY,
+    TEST_ROTATED,
+    TEST_PRESENT,
+    TESTS
+};
+
+static const struct
+{
+    const char *name;
+    const char *column; // table heading
+    const char *unit;
+    const char *key;    // of the rate in the JSON
+} tests[TESTS] = {
+    {"clear", "clear", "Mpix/s", "mpix_per_s"},
+    {"fill_rect", "fill", "Mpix/s", "mpix_per_s"},
+    {"update_texture", "update", "MB/s", "mb_per_s"},
+    {"lock_texture", "lock", "MB/s", "mb_per_s"},
+    {"copy", "copy", "Mpix/s", "mpix_per_s"},
+    {"copy_rotated", "rotated", "Mpix/s", "mpix_per_s"},
+    {"present", "present", "us", NULL},
+};
+
+struct result
+{
+    const char *name;
+    Uint32 flags;  // of the created renderer
+    int ok;
+    int offscreen; // drew into a target texture
+    char error[128];
+    double us[TESTS];   // per operation
+    double rate[TESTS]; // in the unit of the test
+    double frame_ms;    // the show_buttons frame
+};
+
+struct bench
+{
+    SDL_Renderer *renderer;
+    SDL_Texture *target;    // NULL: draw to the window
+    SDL_Texture *source;    // BENCH_SOURCE squared, static
+    SDL_Texture *streaming; // BENCH_WIDTH x BENCH_HEIGHT
+    Uint32 *pixels;         // BENCH_WIDTH x BENCH_HEIGHT
+    SDL_Rect rects[BENCH_RECTS];
+    Uint8 color;
+};
+
+static double now_us(void)
+{
+    return SDL_GetPerformanceCounter() * 1e6 / SDL_GetPerformanceFrequency();
+}
+
+/* wait for the GPU: reading a pixel back cannot complete before the drawing */
+static void finish(struct bench *b)
+{
+    const SDL_Rect one = {0, 0, 1, 1};
+    Uint32 pixel;
+    SDL_RenderReadPixels(b->renderer, &one, SDL_PIXELFORMAT_ARGB8888, &pixel, sizeof(pixel));
+}
+
+static int run_op(struct bench *b, int test)
+{
+    SDL_Renderer *r = b->renderer;
+    void *pixels;
+    int pitch;
+
+    b->color++;
+    switch (test)
+    {
+    case TEST_CLEAR:
+        SDL_SetRenderDrawColor(r, b->color, 0, 255 - b->color, SDL_ALPHA_OPAQUE);
+        return SDL_RenderClear(r);
+    case TEST_FILL:
+        SDL_SetRenderDrawColor(r, 255 - b->color, b->color, 0, SDL_ALPHA_OPAQUE);
+        return SDL_RenderFillRects(r, b->rects, BENCH_RECTS);
+    case TEST_UPDATE:
+        b->pixels[0] = b->color;
+        return SDL_UpdateTexture(b->streaming, NULL, b->pixels, BENCH_WIDTH * sizeof(Uint32));
+    case TEST_LOCK:
+        if (SDL_LockTexture(b->streaming, NULL, &pixels, &pitch) != 0)
+        {
+            return -1;
+        }
+        b->pixels[0] = b->color;
+        for (int y = 0; y < BENCH_HEIGHT; y++)
+        {
+            memcpy((Uint8 *)pixels + y * pitch, b->pixels + y * BENCH_WIDTH, BENCH_WIDTH * sizeof(Uint32));
+        }
+        SDL_UnlockTexture(b->streaming);
+        return 0;
+    case TEST_COPY:
+        return SDL_RenderCopy(r, b->source, NULL, NULL);
+    case TEST_ROTATED:
+        return SDL_RenderCopyEx(r, b->source, NULL, NULL, b->color * (360.0 / 256), NULL, SDL_FLIP_NONE);
+    case TEST_PRESENT:
+        SDL_SetRenderDrawColor(r, b->color, b->color, b->color, SDL_ALPHA_OPAQUE);
+        if (SDL_RenderClear(r) != 0)
+        {
+            return -1;
+        }
+        SDL_RenderPresent(r);
+        return 0;
+    }
+    return -1;
+}
+
+static int run_test(struct bench *b, int test, struct result *res)
+{
+    // pixels or bytes per operation, so per microsecond gives M per second
+    static const double per_op[TESTS] = {
+        BENCH_WIDTH * BENCH_HEIGHT,
+        BENCH_RECTS * 64 * 64,
+        BENCH_WIDTH * BENCH_HEIGHT * 4,
+        BENCH_WIDTH * BENCH_HEIGHT * 4,
+        BENCH_WIDTH * BENCH_HEIGHT,
+        BENCH_WIDTH * BENCH_HEIGHT,
+        0,
+    };
+    long ops = 0;
+
+    // present always goes to the window, everything else to the target
+    if (SDL_SetRenderTarget(b->renderer, test == TEST_PRESENT ? NULL : b->target) != 0)
+    {
+        return -1;
+    }
+    // warm up: first use may compile shaders or allocate
+    for (int i = 0; i < 3; i++)
+    {
+        if (run_op(b, test) != 0)
+        {
+            return -1;
+        }
+    }
+    finish(b);
+
+    const double start = now_us();
+    double elapsed;
+    do
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            if (run_op(b, test) != 0)
+            {
+                return -1;
+            }
+        }
+        ops += 8;
+        finish(b);
+        elapsed = now_us() - start;
+    } while (elapsed < BENCH_SECONDS * 1e6);
+
+    res->us[test] = elapsed / ops;
+    res->rate[test] = per_op[test] ? per_op[test] / res->us[test] : res->us[test];
+    return 0;
+}
+
+static void bench_driver(int index, const char *name, struct result *res)
+{
+    struct bench b = {0};
+    SDL_Window *window = NULL;
+    SDL_RendererInfo info;
+    Uint32 *square = NULL;
+
+    res->name = name;
+    window = SDL_CreateWindow(name, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, BENCH_WIDTH, BENCH_HEIGHT,
+                              SDL_WINDOW_HIDDEN);
+    if (window == NULL || (b.renderer = SDL_CreateRenderer(window, index, 0)) == NULL)
+    {
+        snprintf(res->error, sizeof(res->error), "%s", SDL_GetError());
+        goto done;
+    }
+    if (SDL_GetRendererInfo(b.renderer, &info) == 0)
+    {
+        res->flags = info.flags;
+        if (info.flags & SDL_RENDERER_TARGETTEXTURE)
+        {
+            b.target = SDL_CreateTexture(b.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                         BENCH_WIDTH, BENCH_HEIGHT);
+        }
+    }
+    res->offscreen = b.target != NULL;
+
+    b.pixels = SDL_malloc(BENCH_WIDTH * BENCH_HEIGHT * sizeof(Uint32));
+    square = SDL_malloc(BENCH_SOURCE * BENCH_SOURCE * sizeof(Uint32));
+    b.streaming = SDL_CreateTexture(b.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                    BENCH_WIDTH, BENCH_HEIGHT);
+    b.source = SDL_CreateTexture(b.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                 BENCH_SOURCE, BENCH_SOURCE);
+    if (b.pixels == NULL || square == NULL || b.streaming == NULL || b.source == NULL)
+    {
+        snprintf(res->error, sizeof(res->error), "%s", SDL_GetError());
+        goto done;
+    }
+    for (int i = 0; i < BENCH_WIDTH * BENCH_HEIGHT; i++)
+    {
+        b.pixels[i] = 0xff000000 | (i * 2654435761u >> 8);
+    }
+    for (int y = 0; y < BENCH_SOURCE; y++)
+    {
+        for (int x = 0; x < BENCH_SOURCE; x++)
+        {
+            square[y * BENCH_SOURCE + x] = 0xff000000 | (x << 16) | (y << 8) | ((x ^ y) & 0xff);
+        }
+    }
+    SDL_UpdateTexture(b.source, NULL, square, BENCH_SOURCE * sizeof(Uint32));
+    for (int i = 0; i < BENCH_RECTS; i++)
+    {
+        b.rects[i].x = i * 97 % (BENCH_WIDTH - 64);
+        b.rects[i].y = i * 53 % (BENCH_HEIGHT - 64);
+        b.rects[i].w = b.rects[i].h = 64;
+    }
+
+    for (int t = 0; t < TESTS; t++)
+    {
+        if (run_test(&b, t, res) != 0)
+        {
+            snprintf(res->error, sizeof(res->error), "%s: %s", tests[t].name, SDL_GetError());
+            goto done;
+        }
+    }
+    res->ok = 1;
+    // the present test clears before presenting, so it already holds the frame's clear
+    res->frame_ms = (res->us[TEST_ROTATED] + res->us[TEST_FILL] * 4 / BENCH_RECTS + res->us[TEST_PRESENT] +
+                     res->us[TEST_UPDATE] / BENCH_UPLOAD_FRAMES) /
+                    1000;
+
+done:
+    SDL_free(square);
+    SDL_free(b.pixels);
+    if (b.renderer != NULL)
+    {
+        // destroys the textures with it
+        SDL_DestroyRenderer(b.renderer);
+    }
+    if (window != NULL)
+    {
+        SDL_DestroyWindow(window);
+    }
+}
+
+static void print_table(FILE *f, const struct result *results, int count, int best)
+{
+    fprintf(f, "%-12s %-4s", "driver", "off");
+    for (int t = 0; t < TESTS; t++)
+    {
+        fprintf(f, " %10s", tests[t].column);
+    }
+    fprintf(f, " %10s\n%-17s", "frame", "");
+    for (int t = 0; t < TESTS; t++)
+    {
+        fprintf(f, " %10s", tests[t].unit);
+    }
+    fprintf(f, " %10s\n", "ms");
+
+    for (int i = 0; i < count; i++)
+    {
+        const struct result *res = &results[i];
+        fprintf(f, "%-12s %-4s", res->name, res->ok ? (res->offscreen ? "yes" : "no") : "-");
+        if (!res->ok)
+        {
+            fprintf(f, " failed: %s\n", res->error);
+            continue;
+        }
+        for (int t = 0; t < TESTS; t++)
+        {
+            fprintf(f, " %10.1f", res->rate[t]);
+        }
+        fprintf(f, " %10.3f%s\n", res->frame_ms, i == best ? " *" : "");
+    }
+    if (best >= 0)
+    {
+        fprintf(f, "recommended: SDL_RENDER_DRIVER=%s (%.3f ms per show_buttons frame)\n", results[best].name,
+                results[best].frame_ms);
+    }
+    else
+    {
+        fprintf(f, "no render driver worked\n");
+    }
+}
+
+static void print_json(FILE *f, const struct result *results, int count, int best)
+{
+    fprintf(f, "{\"width\": %d, \"height\": %d, \"seconds_per_test\": %.2f, \"recommended\": ", BENCH_WIDTH,
+            BENCH_HEIGHT, BENCH_SECONDS);
+    if (best >= 0)
+    {
+        json_string(f, results[best].name);
+    }
+    else
+    {
+        fprintf(f, "null");
+    }
+    fprintf(f, ", \"drivers\": [");
+    for (int i = 0; i < count; i++)
+    {
+        const struct result *res = &results[i];
+
+        fprintf(f, "%s\n  {\"name\": ", i ? "," : "");
+        json_string(f, res->name);
+        if (!res->ok)
+        {
+            fprintf(f, ", \"ok\": false, \"error\": ");
+            json_string(f, res->error);
+            fprintf(f, "}");
+            continue;
+        }
+        fprintf(f, ", \"ok\": true, \"offscreen\": %s, \"accelerated\": %s, \"frame_ms\": %.4f,",
+                res->offscreen ? "true" : "false", res->flags & SDL_RENDERER_ACCELERATED ? "true" : "false",
+                res->frame_ms);
+        for (int t = 0; t < TESTS; t++)
+        {
+            fprintf(f, "%s\n   \"%s\": {\"us\": %.3f", t ? "," : "", tests[t].name, res->us[t]);
+            if (tests[t].key != NULL)
+            {
+                fprintf(f, ", \"%s\": %.1f", tests[t].key, res->rate[t]);
+            }
+            fprintf(f, "}");
+        }
+        fprintf(f, "}");
+    }
+    fprintf(f, "]}\n");
+}
+
+int bench_renderers(FILE *table, FILE *json)
+{
+    struct result results[BENCH_MAX_DRIVERS];
+    int count = SDL_GetNumRenderDrivers();
+    int best = -1;
+
+    if (count > BENCH_MAX_DRIVERS)
+    {
+        count = BENCH_MAX_DRIVERS;
+    }
+    SDL_memset(results, 0, sizeof(results));
+    for (int i = 0; i < count; i++)
+    {
+        SDL_RendererInfo info;
+        if (SDL_GetRenderDriverInfo(i, &info) != 0)
+        {
+            results[i].name = "?";
+            snprintf(results[i].error, sizeof(results[i].error), "%s", SDL_GetError());
+            continue;
+        }
+        if (table != NULL)
+        {
+            fprintf(stderr, "benchmarking %s\n", info.name);
+        }
+        bench_driver(i, info.name, &results[i]);
+        if (results[i].ok && (best < 0 || results[i].frame_ms < results[best].frame_ms))
+        {
+            best = i;
+        }
+    }
+
+    if (table != NULL)
+    {
+        print_table(table, results, count, best);
+    }
+    if (json != NULL)
+    {
+        print_json(json, results, count, best);
+    }
+    return best;
+}
@@ -0,0 +1,31 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+
+/*
+ * Render driver benchmark.
+ *
+ * Every driver SDL_GetRenderDriverInfo() reports gets a hidden window and a
+ * renderer of its own, and draws into a BENCH_WIDTH x BENCH_HEIGHT target
+ * texture when the driver supports one, so nothing shows on screen.  Each test
+ * repeats one operation for BENCH_SECONDS and ends with a one pixel
+ * SDL_RenderReadPixels(), so work still queued on the GPU is counted.
+ *
+ * The recommendation is the driver with the cheapest show_buttons frame:
+ * a clear, a rotated full screen copy, a few rects and a present, plus a
+ * full screen upload every BENCH_UPLOAD_FRAMES frames for the next image.
+ */
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+#define BENCH_SECONDS 0.25
+#define BENCH_UPLOAD_FRAMES 300
+
+/*
+ * Run every render driver, print a table to table and JSON to json; either
+ * may be NULL.  Returns the index of the recommended driver, or -1 if none
+ * worked.
+ */
+int bench_renderers(FILE *table, FILE *json);
+
+#endif /* BENCH_H */
@@ -1,8 +1,16 @@
+#include <errno.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <SDL2/SDL.h>
 
+#include "bench.h"
+#include "frame_pacer.h"
+#include "probe.h"
+
 #define HANDLE_SDL_ERROR(ret, msg)                     \
     do                                                 \
     {                                                  \
@@ -75,23 +83,114 @@ void dump_sdl_info()
     }
 }
 
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [-p [-t timeout_ms] [-c cache | -n] [-f]] [-b [-o json]]\n"
+            "  -p  probe every video driver in parallel, print JSON and exit\n"
+            "  -t  per-driver probe timeout (default %d ms)\n"
+            "  -c  probe cache file (default %s)\n"
+            "  -n  do not use a probe cache\n"
+            "  -f  probe even if the cache is current\n"
+            "  -b  benchmark every render driver, print a table and exit\n"
+            "  -o  also write the benchmark as JSON to a file, - for stdout instead of the table\n",
+            argv0, PROBE_TIMEOUT_MS, probe_default_cache() ? probe_default_cache() : "none");
+}
+
 int main(int argc, char *argv[])
 {
     _Bool success = false;
     int ret = 0;
     SDL_Window *window = NULL;
     SDL_Renderer *renderer = NULL;
+    struct frame_pacer pacer = {0};
+    _Bool probe = false, force = false, bench = false;
+    const char *bench_json = NULL;
+    int timeout_ms = PROBE_TIMEOUT_MS;
+    const char *cache = probe_default_cache();
+    int opt;
+
+    while ((opt = getopt(argc, argv, "pt:c:nfbo:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            probe = true;
+            break;
+        case 't':
+            timeout_ms = atoi(optarg);
+            break;
+        case 'c':
+            cache = optarg;
+            break;
+        case 'n':
+            cache = NULL;
+            break;
+        case 'f':
+            force = true;
+            break;
+        case 'b':
+            bench = true;
+            break;
+        case 'o':
+            bench_json = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc || timeout_ms <= 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
 
     // NOTE: Calling SDL_VideoInit() after SDL_Init(INIT_VIDEO)
     // will corrupt the stack!
     ret = SDL_Init(0);
     HANDLE_SDL_ERROR(ret, "SDL_Init(0)");
 
-    dump_sdl_info();
+    if (probe)
+    {
+        const Uint64 start = SDL_GetPerformanceCounter();
+        int cached;
+
+        ret = probe_video(stdout, cache, timeout_ms, force, &cached);
+        HANDLE_SDL_ERROR(ret, "probe_video");
+        fprintf(stderr, "probe: %s in %.1f ms\n", cached ? "cache hit" : "probed",
+                (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+        success = true;
+        goto done;
+    }
+
+    // the benchmark output is a table or JSON and nothing else
+    if (!bench)
+    {
+        dump_sdl_info();
+    }
 
     ret = SDL_Init(SDL_INIT_VIDEO);
     HANDLE_SDL_ERROR(ret, "SDL_Init(SDL_INIT_VIDEO)");
 
+    if (bench)
+    {
+        const _Bool to_stdout = bench_json != NULL && strcmp(bench_json, "-") == 0;
+        FILE *json = to_stdout ? stdout : NULL;
+
+        if (bench_json != NULL && !to_stdout && (json = fopen(bench_json, "w")) == NULL)
+        {
+            printf("%s: %s\n", bench_json, strerror(errno));
+            goto done;
+        }
+        success = bench_renderers(to_stdout ? NULL : stdout, json) >= 0;
+        if (json != NULL && json != stdout)
+        {
+            fclose(json);
+        }
+        goto done;
+    }
+
     SDL_RendererInfo renderer_info;
 
     const int renderDrivers = SDL_GetNumRenderDrivers();
@@ -112,7 +211,7 @@ int main(int argc, char *argv[])
                               SDL_WINDOW_SHOWN | SDL_WINDOW_FULLSCREEN);
     HANDLE_SDL_ERROR(window == NULL, "SDL_CreateWindow");
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     HANDLE_SDL_ERROR(renderer == NULL, "SDL_CreateRenderer");
 
     SDL_ShowCursor(SDL_DISABLE);
@@ -121,6 +220,10 @@ int main(int argc, char *argv[])
     HANDLE_SDL_ERROR(ret, "SDL_GetRendererInfo");
     printf("active renderer: %s\n", renderer_info.name);
 
+    SDL_DisplayMode display_mode = {0};
+    SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &display_mode);
+    frame_pacer_init(&pacer, display_mode.refresh_rate, (renderer_info.flags & SDL_RENDERER_PRESENTVSYNC) != 0);
+
     Uint8 color = 0;
 
     _Bool running = true;
@@ -153,12 +256,14 @@ int main(int argc, char *argv[])
 
         SDL_RenderPresent(renderer);
 
-        SDL_Delay(1000 / 60);
+        frame_pacer_wait(&pacer);
 
         ++color;
     }
 
 done:
+    frame_pacer_report(&pacer, stdout);
+
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
 
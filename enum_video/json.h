@@ -0,0 +1,28 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdio.h>
+
+/* str as a quoted JSON string, with quotes, backslashes and control characters escaped */
+static inline void json_string(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+        {
+            fprintf(f, "\\%c", *str);
+        }
+        else if ((unsigned char)*str < 0x20)
+        {
+            fprintf(f, "\\u%04x", *str);
+        }
+        else
+        {
+            fputc(*str, f);
+        }
+    }
+    fputc('"', f);
+}
+
+#endif /* JSON_H */
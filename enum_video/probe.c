@@ -0,0 +1,524 @@
+#define _GNU_SOURCE // pipe2
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <SDL2/SDL.h>
+
+#include "probe.h"
+#include "json.h"
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/* the display configuration as the kernel and the session see it */
+static const char *fingerprint_env[] = {
+    "DISPLAY", "WAYLAND_DISPLAY", "XDG_SESSION_TYPE", "SDL_VIDEODRIVER", "SDL_VIDEO_X11_XRANDR",
+};
+static const char *fingerprint_files[] = {
+    "/sys/class/drm/*/status",
+    "/sys/class/drm/*/enabled",
+    "/sys/class/drm/*/modes",
+    "/sys/class/drm/*/edid", // same modes, different monitor: the physical size, and so the DPI, changes
+    "/sys/class/graphics/fb*/modes",
+    "/sys/class/graphics/fb*/virtual_size",
+    "/sys/class/graphics/fb*/bits_per_pixel",
+};
+
+struct child
+{
+    const char *driver;
+    pid_t pid;
+    int fd;        // read end of the pipe, -1 once closed
+    char *out;
+    size_t len;
+    size_t cap;
+    int status;    // from waitpid()
+    int timed_out;
+    double ms;
+};
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static Uint64 fnv1a(Uint64 h, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ p[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+static Uint64 hash_string(Uint64 h, const char *s)
+{
+    // include the terminator so "ab" + "c" differs from "a" + "bc"
+    return fnv1a(h, s, strlen(s) + 1);
+}
+
+static Uint64 hash_file(Uint64 h, const char *path)
+{
+    char buf[4096];
+    ssize_t n;
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    h = hash_string(h, path);
+    if (fd < 0)
+    {
+        return hash_string(h, "<missing>");
+    }
+    // sysfs reports a size of 4096 whatever the content, so read to the end
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+        h = fnv1a(h, buf, n);
+    }
+    close(fd);
+    return h;
+}
+
+static Uint64 fingerprint(void)
+{
+    Uint64 h = FNV_OFFSET;
+    SDL_version version;
+
+    SDL_GetVersion(&version);
+    h = fnv1a(h, &version, sizeof(version));
+    for (int i = 0; i < SDL_GetNumVideoDrivers(); i++)
+    {
+        h = hash_string(h, SDL_GetVideoDriver(i));
+    }
+    for (size_t i = 0; i < SDL_arraysize(fingerprint_env); i++)
+    {
+        const char *value = getenv(fingerprint_env[i]);
+        h = hash_string(h, fingerprint_env[i]);
+        h = hash_string(h, value ? value : "<unset>");
+    }
+    for (size_t i = 0; i < SDL_arraysize(fingerprint_files); i++)
+    {
+        glob_t g;
+        if (glob(fingerprint_files[i], 0, NULL, &g) == 0)
+        {
+            for (size_t j = 0; j < g.gl_pathc; j++)
+            {
+                h = hash_file(h, g.gl_pathv[j]);
+            }
+        }
+        globfree(&g);
+    }
+    return h;
+}
+
+static void json_rect(FILE *f, const SDL_Rect *r)
+{
+    fprintf(f, "[%d, %d, %d, %d]", r->x, r->y, r->w, r->h);
+}
+
+/* in the child: the fields of one driver's entry, after "name" */
+static void report_driver(FILE *f, const char *driver)
+{
+    if (SDL_VideoInit(driver) != 0)
+    {
+        fprintf(f, ", \"status\": \"error\", \"error\": ");
+        json_string(f, SDL_GetError());
+        return;
+    }
+
+    fprintf(f, ", \"status\": \"ok\", \"displays\": [");
+    const int displays = SDL_GetNumVideoDisplays();
+    for (int d = 0; d < displays; d++)
+    {
+        const char *name = SDL_GetDisplayName(d);
+        float ddpi, hdpi, vdpi;
+        SDL_Rect rect;
+
+        fprintf(f, "%s\n    {\"index\": %d, \"name\": ", d ? "," : "", d);
+        json_string(f, name ? name : "");
+        if (SDL_GetDisplayBounds(d, &rect) == 0)
+        {
+            fprintf(f, ", \"bounds\": ");
+            json_rect(f, &rect);
+        }
+        if (SDL_GetDisplayUsableBounds(d, &rect) == 0)
+        {
+            fprintf(f, ", \"usable_bounds\": ");
+            json_rect(f, &rect);
+        }
+        if (SDL_GetDisplayDPI(d, &ddpi, &hdpi, &vdpi) == 0)
+        {
+            fprintf(f, ", \"dpi\": {\"d\": %.2f, \"h\": %.2f, \"v\": %.2f}", ddpi, hdpi, vdpi);
+        }
+
+        fprintf(f, ", \"modes\": [");
+        const int modes = SDL_GetNumDisplayModes(d);
+        int emitted = 0; // a mode that cannot be read is skipped, so m > 0 does not mean a comma is due
+        for (int m = 0; m < modes; m++)
+        {
+            SDL_DisplayMode mode;
+            if (SDL_GetDisplayMode(d, m, &mode) == 0)
+            {
+                fprintf(f, "%s\n      {\"format\": \"%s\", \"w\": %d, \"h\": %d, \"refresh_rate\": %d}",
+                        emitted ? "," : "", SDL_GetPixelFormatName(mode.format), mode.w, mode.h, mode.refresh_rate);
+                emitted++;
+            }
+        }
+        fprintf(f, "]}");
+    }
+    fprintf(f, "]");
+    SDL_VideoQuit();
+}
+
+/* runs in the forked child, never returns */
+static void child_main(const char *driver, int fd)
+{
+    char *buf = NULL;
+    size_t len = 0;
+
+    // drivers may print to stdout, which is where the parent writes its report
+    const int null = open("/dev/null", O_WRONLY);
+    if (null >= 0)
+    {
+        dup2(null, STDOUT_FILENO);
+        close(null);
+    }
+
+    // build the whole entry first: a child killed halfway must not leave half of one
+    FILE *f = open_memstream(&buf, &len);
+    if (f == NULL)
+    {
+        _exit(1);
+    }
+    report_driver(f, driver);
+    fclose(f);
+
+    for (size_t off = 0; off < len;)
+    {
+        const ssize_t n = write(fd, buf + off, len - off);
+        if (n < 0 && errno != EINTR)
+        {
+            _exit(1);
+        }
+        off += n > 0 ? n : 0;
+    }
+    _exit(0);
+}
+
+static int spawn(struct child *c)
+{
+    int fds[2];
+
+    if (pipe2(fds, O_CLOEXEC) < 0)
+    {
+        return SDL_SetError("pipe: %s", strerror(errno));
+    }
+    fflush(NULL);
+    c->pid = fork();
+    if (c->pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return SDL_SetError("fork: %s", strerror(errno));
+    }
+    if (c->pid == 0)
+    {
+        close(fds[0]);
+        child_main(c->driver, fds[1]);
+    }
+    close(fds[1]);
+    c->fd = fds[0];
+    return 0;
+}
+
+/* read what is available; returns 1 once the child closed its end */
+static int drain(struct child *c)
+{
+    if (c->len + 4096 > c->cap)
+    {
+        const size_t cap = c->cap ? 2 * c->cap : 16384;
+        char *out = SDL_realloc(c->out, cap);
+        if (out == NULL)
+        {
+            c->len = 0; // reported as a failed probe rather than half an entry
+            return 1;
+        }
+        c->out = out;
+        c->cap = cap;
+    }
+    const ssize_t n = read(c->fd, c->out + c->len, c->cap - c->len);
+    if (n < 0 && errno == EINTR)
+    {
+        return 0;
+    }
+    if (n <= 0)
+    {
+        return 1;
+    }
+    c->len += n;
+    return 0;
+}
+
+static void reap(struct child *c, double start)
+{
+    close(c->fd);
+    c->fd = -1;
+    while (waitpid(c->pid, &c->status, 0) < 0 && errno == EINTR)
+    {
+    }
+    c->ms = now_ms() - start;
+}
+
+static void run_children(struct child *children, int count, int timeout_ms)
+{
+    struct pollfd fds[PROBE_MAX_DRIVERS];
+    struct child *polled[PROBE_MAX_DRIVERS];
+    const double start = now_ms();
+    int running = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        running += children[i].fd >= 0;
+    }
+    while (running > 0)
+    {
+        const int remaining = (int)(start + timeout_ms - now_ms());
+        int n = 0;
+
+        if (remaining <= 0)
+        {
+            break;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if (children[i].fd >= 0)
+            {
+                fds[n].fd = children[i].fd;
+                fds[n].events = POLLIN;
+                polled[n++] = &children[i];
+            }
+        }
+        if (poll(fds, n, remaining) < 0 && errno != EINTR)
+        {
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            if (fds[i].revents && drain(polled[i]))
+            {
+                reap(polled[i], start);
+                running--;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (children[i].fd >= 0)
+        {
+            kill(children[i].pid, SIGKILL);
+            children[i].timed_out = 1;
+            reap(&children[i], start);
+        }
+    }
+}
+
+static void report(FILE *f, Uint64 print, struct child *children, int count, double ms)
+{
+    SDL_version version;
+
+    SDL_GetVersion(&version);
+    // the fingerprint stays alone on the first line, the cache reader looks for it there
+    fprintf(f, "{\"fingerprint\": \"%016llx\",\n", (unsigned long long)print);
+    fprintf(f, " \"sdl\": \"%d.%d.%d\", \"probe_ms\": %.1f, \"drivers\": [", version.major, version.minor,
+            version.patch, ms);
+    for (int i = 0; i < count; i++)
+    {
+        const struct child *c = &children[i];
+
+        fprintf(f, "%s\n  {\"name\": ", i ? "," : "");
+        json_string(f, c->driver);
+        fprintf(f, ", \"ms\": %.1f", c->ms);
+        if (c->timed_out)
+        {
+            fprintf(f, ", \"status\": \"timeout\"");
+        }
+        else if (c->pid < 0)
+        {
+            fprintf(f, ", \"status\": \"error\", \"error\": \"could not start a probe process\"");
+        }
+        else if (WIFSIGNALED(c->status))
+        {
+            fprintf(f, ", \"status\": \"crashed\", \"signal\": %d", WTERMSIG(c->status));
+        }
+        else if (!WIFEXITED(c->status) || WEXITSTATUS(c->status) != 0 || c->len == 0)
+        {
+            fprintf(f, ", \"status\": \"error\", \"error\": \"probe process failed\"");
+        }
+        else
+        {
+            fwrite(c->out, 1, c->len, f);
+        }
+        fprintf(f, "}");
+    }
+    fprintf(f, "]}\n");
+}
+
+/* copy the cache to out if its fingerprint is print */
+static int read_cache(FILE *out, const char *cache, Uint64 print)
+{
+    char line[128], buf[8192];
+    unsigned long long cached;
+    size_t n;
+
+    FILE *f = fopen(cache, "r");
+    if (f == NULL)
+    {
+        return 0;
+    }
+    if (fgets(line, sizeof(line), f) == NULL ||
+        sscanf(line, "{\"fingerprint\": \"%16llx\"", &cached) != 1 || cached != print)
+    {
+        fclose(f);
+        return 0;
+    }
+    fputs(line, out);
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        fwrite(buf, 1, n, out);
+    }
+    fclose(f);
+    return 1;
+}
+
+/* replace the cache atomically, so a concurrent start never reads half a report */
+static void write_cache(const char *cache, const char *data, size_t len)
+{
+    char dir[4096], tmp[4096];
+
+    // create the directory, one level: ~/.cache itself may not exist yet on a fresh kiosk
+    snprintf(dir, sizeof(dir), "%s", cache);
+    char *slash = strrchr(dir, '/');
+    if (slash != NULL && slash != dir)
+    {
+        *slash = '\0';
+        char *parent = strrchr(dir, '/');
+        if (parent != NULL && parent != dir)
+        {
+            *parent = '\0';
+            mkdir(dir, 0700);
+            *parent = '/';
+        }
+        mkdir(dir, 0700);
+    }
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", cache, (int)getpid());
+    FILE *f = fopen(tmp, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "probe: cannot write %s: %s\n", tmp, strerror(errno));
+        return;
+    }
+    const int ok = fwrite(data, 1, len, f) == len;
+    if (fclose(f) != 0 || !ok || rename(tmp, cache) != 0)
+    {
+        fprintf(stderr, "probe: cannot write %s: %s\n", cache, strerror(errno));
+        unlink(tmp);
+    }
+}
+
+const char *probe_default_cache(void)
+{
+    static char path[4096];
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if (xdg != NULL && *xdg == '/')
+    {
+        snprintf(path, sizeof(path), "%s/enum_video/probe.json", xdg);
+    }
+    else if (home != NULL && *home != '\0')
+    {
+        snprintf(path, sizeof(path), "%s/.cache/enum_video/probe.json", home);
+    }
+    else
+    {
+        return NULL;
+    }
+    return path;
+}
+
+int probe_video(FILE *out, const char *cache, int timeout_ms, int force, int *cached)
+{
+    struct child children[PROBE_MAX_DRIVERS];
+    const Uint64 print = fingerprint();
+    const double start = now_ms();
+    int count = SDL_GetNumVideoDrivers();
+    char *buf = NULL;
+    size_t len = 0;
+
+    *cached = 0;
+    if (cache != NULL && !force && read_cache(out, cache, print))
+    {
+        *cached = 1;
+        return 0;
+    }
+
+    if (count > PROBE_MAX_DRIVERS)
+    {
+        count = PROBE_MAX_DRIVERS;
+    }
+    SDL_memset(children, 0, sizeof(children));
+    for (int i = 0; i < count; i++)
+    {
+        children[i].driver = SDL_GetVideoDriver(i);
+        children[i].fd = -1;
+        if (spawn(&children[i]) < 0)
+        {
+            fprintf(stderr, "probe %s: %s\n", children[i].driver, SDL_GetError());
+            children[i].pid = -1;
+        }
+    }
+    run_children(children, count, timeout_ms);
+
+    // a driver that stalled or crashed may well work next time, e.g. once X is up after boot
+    int transient = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (children[i].timed_out || children[i].pid < 0 || WIFSIGNALED(children[i].status))
+        {
+            transient = 1;
+        }
+    }
+
+    FILE *f = open_memstream(&buf, &len);
+    if (f == NULL)
+    {
+        return SDL_SetError("open_memstream: %s", strerror(errno));
+    }
+    report(f, print, children, count, now_ms() - start);
+    fclose(f);
+    for (int i = 0; i < count; i++)
+    {
+        SDL_free(children[i].out);
+    }
+
+    fwrite(buf, 1, len, out);
+    if (cache != NULL && !transient)
+    {
+        write_cache(cache, buf, len);
+    }
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdio.h>
+
+/*
+ * Parallel, cached video driver probe.
+ *
+ * Every driver is initialized in a child process of its own, all of them
+ * at once, so a driver that hangs costs at most the timeout and one that
+ * crashes takes nothing else down.  Each child reports its displays, modes,
+ * DPI and bounds as JSON over a pipe.
+ *
+ * The combined report is cached with a fingerprint of what it depends on:
+ * the SDL version, the driver list, the display related environment
+ * variables and the connector, monitor EDID and framebuffer state under
+ * /sys/class/drm and /sys/class/graphics.  While the fingerprint matches,
+ * the cached report is printed without probing anything; -f forces a new
+ * probe.  A report in which a driver timed out or crashed is not cached,
+ * since the next start may find it working.
+ */
+#define PROBE_TIMEOUT_MS 2000
+#define PROBE_MAX_DRIVERS 32
+
+/*
+ * Write the report to out.  cache may be NULL to neither read nor write
+ * one.  Returns 0 on success, -1 (see SDL_GetError()) on failure; *cached
+ * tells whether the report came from the cache.
+ */
+int probe_video(FILE *out, const char *cache, int timeout_ms, int force, int *cached);
+/* $XDG_CACHE_HOME/enum_video/probe.json, or ~/.cache/enum_video/probe.json */
+const char *probe_default_cache(void);
+
+#endif /* PROBE_H */
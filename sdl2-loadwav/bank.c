@@ -0,0 +1,112 @@
+#include <string.h>
+
+#include "bank.h"
+#include "convert.h"
+#include "wav.h"
+
+// grow *p to hold at least need elements of size, doubling
+static int reserve(void **p, Uint32 *cap, Uint32 need, size_t size)
+{
+    Uint32 n = *cap ? *cap : 4096;
+    void *q;
+
+    if (need <= *cap)
+        return 0;
+    while (n < need)
+        n *= 2;
+    if ((q = SDL_realloc(*p, (size_t)n * size)) == NULL)
+        return SDL_OutOfMemory();
+    *p = q;
+    *cap = n;
+    return 0;
+}
+
+// append one sound's samples, converted, to the arena
+static int bank_add(struct bank *b, Uint32 *arena_cap, const SDL_AudioSpec *spec, const Uint8 *data, Uint32 len)
+{
+    struct bank_entry *e = &b->index[b->count];
+    struct converter cv;
+
+    if (converter_init(&cv, spec->format, spec->channels, spec->freq, AUDIO_S16LSB, b->channels, b->freq,
+                       CONVERT_BEST) < 0)
+        return -1;
+    if (reserve((void **)&b->arena, arena_cap, b->arena_len + converter_max_output(&cv, len) / sizeof(Sint16),
+                sizeof(Sint16)) < 0)
+    {
+        converter_free(&cv);
+        return -1;
+    }
+
+    Uint8 *out = (Uint8 *)(b->arena + b->arena_len);
+    size_t written = converter_process(&cv, data, len, out);
+    written += converter_flush(&cv, out + written);
+    converter_free(&cv);
+
+    e->offset = b->arena_len;
+    e->frames = written / (sizeof(Sint16) * b->channels);
+    b->arena_len += e->frames * b->channels;
+    return 0;
+}
+
+int bank_load(struct bank *b, char **files, int count, int freq, int channels)
+{
+    Uint32 arena_cap = 0, names_cap = 0;
+    char error[256];
+
+    SDL_zerop(b);
+    b->freq = freq;
+    b->channels = channels;
+    if ((b->index = SDL_calloc(count, sizeof(*b->index))) == NULL)
+        return SDL_OutOfMemory();
+
+    for (int i = 0; i < count; i++)
+    {
+        struct wav_map wav;
+        Uint8 *buf = NULL;
+        int ret;
+
+        if (wav_map(files[i], &wav) == 0)
+        {
+            ret = bank_add(b, &arena_cap, &wav.spec, wav.data, wav.data_len);
+            wav_unmap(&wav);
+        }
+        else if (SDL_LoadWAV(files[i], &wav.spec, &buf, &wav.data_len))
+        {
+            // ADPCM and other encoded data
+            ret = bank_add(b, &arena_cap, &wav.spec, buf, wav.data_len);
+            SDL_FreeWAV(buf);
+        }
+        else
+            ret = -1;
+
+        const Uint32 name_len = strlen(files[i]) + 1;
+        if (ret == 0 && reserve((void **)&b->names, &names_cap, b->names_len + name_len, 1) < 0)
+            ret = -1;
+        if (ret < 0)
+        {
+            SDL_strlcpy(error, SDL_GetError(), sizeof(error));
+            bank_free(b);
+            return SDL_SetError("%s: %s", files[i], error);
+        }
+        memcpy(b->names + b->names_len, files[i], name_len);
+        b->index[b->count++].name = b->names_len;
+        b->names_len += name_len;
+    }
+
+    // give back what the doubling over-allocated
+    if (b->arena_len > 0 && arena_cap > b->arena_len)
+    {
+        Sint16 *arena = SDL_realloc(b->arena, b->arena_len * sizeof(Sint16));
+        if (arena)
+            b->arena = arena;
+    }
+    return 0;
+}
+
+void bank_free(struct bank *b)
+{
+    SDL_free(b->arena);
+    SDL_free(b->index);
+    SDL_free(b->names);
+    SDL_zerop(b);
+}
@@ -0,0 +1,51 @@
+#ifndef BANK_H
+#define BANK_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * A bank of short sounds, preloaded for the mixer.
+ *
+ * Every sound is converted once, at load time, to S16 at the device's rate
+ * and channel count and appended to a single arena, so playing one is a
+ * pointer into memory that is already resident.  The index holds an offset
+ * and a length per sound; names live in one string pool.
+ */
+struct bank_entry
+{
+    Uint32 offset; // samples into the arena
+    Uint32 frames;
+    Uint32 name;   // offset into names
+};
+
+struct bank
+{
+    int freq;
+    int channels;
+    Sint16 *arena;
+    Uint32 arena_len; // samples
+    struct bank_entry *index;
+    int count;
+    char *names;
+    Uint32 names_len;
+};
+
+/*
+ * Load files for a device running at freq with channels, S16.  PCM files
+ * are mapped, anything else goes through SDL_LoadWAV.  Returns 0 on
+ * success, -1 (see SDL_GetError()) if any file cannot be loaded.
+ */
+int bank_load(struct bank *b, char **files, int count, int freq, int channels);
+void bank_free(struct bank *b);
+
+static inline const Sint16 *bank_samples(const struct bank *b, int sound)
+{
+    return b->arena + b->index[sound].offset;
+}
+
+static inline const char *bank_name(const struct bank *b, int sound)
+{
+    return b->names + b->index[sound].name;
+}
+
+#endif /* BANK_H */
@@ -0,0 +1,154 @@
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+#include "wav.h"
+
+static int add_file(struct batch *b, const char *path, off_t size)
+{
+    if (b->count == b->cap)
+    {
+        const int cap = b->cap ? 2 * b->cap : 256;
+        struct batch_file *files = SDL_realloc(b->files, cap * sizeof(*files));
+        if (files == NULL)
+            return SDL_OutOfMemory();
+        b->files = files;
+        b->cap = cap;
+    }
+    struct batch_file *f = &b->files[b->count];
+    SDL_zerop(f);
+    if ((f->path = SDL_strdup(path)) == NULL)
+        return SDL_OutOfMemory();
+    f->size = size;
+    b->count++;
+    return 0;
+}
+
+static int is_wav(const char *name)
+{
+    const size_t len = strlen(name);
+    return len > 4 && !strcasecmp(name + len - 4, ".wav");
+}
+
+// directory symlinks are not followed, so a link loop cannot recurse forever
+static int scan_dir(struct batch *b, const char *dir)
+{
+    DIR *d = opendir(dir);
+    struct dirent *e;
+    int ret = 0;
+
+    if (d == NULL)
+        return SDL_SetError("opendir(\"%s\"): %s", dir, strerror(errno));
+    while (ret == 0 && (e = readdir(d)) != NULL)
+    {
+        char path[4096];
+        struct stat st;
+
+        if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+            continue;
+        if (snprintf(path, sizeof(path), "%s/%s", dir, e->d_name) >= (int)sizeof(path) || lstat(path, &st) < 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            ret = scan_dir(b, path);
+        else if (is_wav(e->d_name) && (S_ISREG(st.st_mode) || (S_ISLNK(st.st_mode) && stat(path, &st) == 0 && S_ISREG(st.st_mode))))
+            ret = add_file(b, path, st.st_size);
+    }
+    closedir(d);
+    return ret;
+}
+
+static int by_path(const void *a, const void *b)
+{
+    return strcmp(((const struct batch_file *)a)->path, ((const struct batch_file *)b)->path);
+}
+
+int batch_scan(struct batch *b, const char *dir)
+{
+    SDL_zerop(b);
+    atomic_init(&b->next, 0);
+    if (scan_dir(b, dir) < 0)
+        return -1;
+    qsort(b->files, b->count, sizeof(*b->files), by_path);
+    return 0;
+}
+
+static void check_file(struct batch_file *f)
+{
+    struct wav_map wav;
+    Uint8 *buf;
+
+    if (!SDL_LoadWAV(f->path, &f->spec, &buf, &f->decoded_len))
+    {
+        snprintf(f->error, sizeof(f->error), "%s", SDL_GetError());
+        return;
+    }
+
+    const int frame = SDL_AUDIO_BITSIZE(f->spec.format) / 8 * f->spec.channels;
+    if (f->spec.channels < 1 || f->spec.channels > 8)
+        snprintf(f->error, sizeof(f->error), "%d channels", f->spec.channels);
+    else if (f->spec.freq < 1000 || f->spec.freq > 384000)
+        snprintf(f->error, sizeof(f->error), "%d Hz", f->spec.freq);
+    else if (f->decoded_len == 0)
+        snprintf(f->error, sizeof(f->error), "no samples");
+    else if (f->decoded_len % frame)
+        snprintf(f->error, sizeof(f->error), "%u bytes is not a whole number of %d byte frames",
+                 f->decoded_len, frame);
+    else if (wav_map(f->path, &wav) == 0)
+    {
+        // plain PCM: the two parsers must agree
+        if (wav.spec.freq != f->spec.freq || wav.spec.format != f->spec.format ||
+            wav.spec.channels != f->spec.channels || wav.data_len != f->decoded_len)
+            snprintf(f->error, sizeof(f->error), "header says %d Hz 0x%04x %d ch %u bytes, SDL decoded %u bytes",
+                     wav.spec.freq, wav.spec.format, wav.spec.channels, wav.data_len, f->decoded_len);
+        else
+            f->ok = 1;
+        wav_unmap(&wav);
+    }
+    else
+        f->ok = 1; // encoded, SDL_LoadWAV is the only decoder
+
+    if (frame > 0 && f->spec.freq > 0)
+        f->seconds = (double)(f->decoded_len / frame) / f->spec.freq;
+    SDL_FreeWAV(buf);
+}
+
+static int worker(void *data)
+{
+    struct batch *b = data;
+    int i;
+
+    while ((i = atomic_fetch_add(&b->next, 1)) < b->count)
+        check_file(&b->files[i]);
+    return 0;
+}
+
+int batch_run(struct batch *b, int threads)
+{
+    SDL_Thread *pool[BATCH_MAX_THREADS];
+    int started = 0;
+
+    if (threads > BATCH_MAX_THREADS)
+        threads = BATCH_MAX_THREADS;
+    atomic_store(&b->next, 0);
+    // the calling thread is one of the workers
+    for (int i = 1; i < threads; i++)
+        if ((pool[started] = SDL_CreateThread(worker, "batch", b)) != NULL)
+            started++;
+    worker(b);
+    for (int i = 0; i < started; i++)
+        SDL_WaitThread(pool[i], NULL);
+    return started + 1;
+}
+
+void batch_free(struct batch *b)
+{
+    for (int i = 0; i < b->count; i++)
+        SDL_free(b->files[i].path);
+    SDL_free(b->files);
+    SDL_zerop(b);
+}
@@ -0,0 +1,44 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <SDL2/SDL.h>
+
+/*
+ * Batch validation of WAV assets, no audio device involved.
+ *
+ * batch_scan() collects every .wav below a directory, batch_run() has a
+ * pool of threads take files off a shared counter and decode each one
+ * with SDL_LoadWAV, then check what came out: a format SDL can play, sane
+ * rate and channels, a whole number of frames, and for plain PCM that the
+ * header agrees with wav_map()'s own parse.
+ */
+#define BATCH_MAX_THREADS 64
+
+struct batch_file
+{
+    char *path;
+    off_t size;      // bytes on disk
+    int ok;
+    char error[160];
+    SDL_AudioSpec spec;
+    Uint32 decoded_len;
+    double seconds;  // of audio
+};
+
+struct batch
+{
+    struct batch_file *files;
+    int count;
+    int cap;
+    atomic_int next; // next file to check
+};
+
+/* returns 0 on success, -1 (see SDL_GetError()) if dir cannot be read */
+int batch_scan(struct batch *b, const char *dir);
+/* check every file on up to threads threads, returns how many ran */
+int batch_run(struct batch *b, int threads);
+void batch_free(struct batch *b);
+
+#endif /* BATCH_H */
@@ -0,0 +1,310 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "convert.h"
+
+/*
+ * -C: run a set of typical conversions through SDL_AudioCVT, SDL_AudioStream
+ * and each converter quality.  Throughput is input seconds converted per
+ * wall-clock second, from the fastest of COMPARE_REPEATS runs after the
+ * path has been set up; quality is the SNR of a converted sine against the
+ * best-fitting sine of the same frequency, so the output delay and gain of
+ * each path do not count as noise.
+ */
+#define COMPARE_SECONDS 2
+#define COMPARE_REPEATS 5         // timed conversions per path; the fastest counts
+#define COMPARE_STREAM_BLOCK 4096 // bytes put per SDL_AudioStreamPut()
+#define COMPARE_EDGE 512          // output frames skipped at either end
+
+struct compare_case
+{
+    const char *name;
+    SDL_AudioFormat src_format;
+    int src_channels, src_rate;
+    SDL_AudioFormat dst_format;
+    int dst_channels, dst_rate;
+};
+
+static const struct compare_case cases[] = {
+    {"S16 2ch 44100 -> F32 2ch 48000", AUDIO_S16LSB, 2, 44100, AUDIO_F32LSB, 2, 48000},
+    {"S16 2ch 44100 -> S16 2ch 48000", AUDIO_S16LSB, 2, 44100, AUDIO_S16LSB, 2, 48000},
+    {"S16 1ch 44100 -> S16 2ch 44100", AUDIO_S16LSB, 1, 44100, AUDIO_S16LSB, 2, 44100},
+    {"F32 2ch 48000 -> S16 2ch 44100", AUDIO_F32LSB, 2, 48000, AUDIO_S16LSB, 2, 44100},
+    {"U8  1ch  8000 -> S16 2ch 48000", AUDIO_U8, 1, 8000, AUDIO_S16LSB, 2, 48000},
+    {"S32 2ch 96000 -> S16 2ch 48000", AUDIO_S32LSB, 2, 96000, AUDIO_S16LSB, 2, 48000},
+    {"S16 2ch 48000 -> F32 2ch 48000", AUDIO_S16LSB, 2, 48000, AUDIO_F32LSB, 2, 48000},
+};
+
+enum
+{
+    PATH_CVT = CONVERT_QUALITIES,
+    PATH_STREAM,
+    PATHS
+};
+
+static const char *path_name(int path)
+{
+    if (path == PATH_CVT)
+        return "SDL_AudioCVT";
+    if (path == PATH_STREAM)
+        return "SDL_AudioStream";
+    return convert_quality_names[path];
+}
+
+// a sine at half scale on every channel, in the source format
+static Uint8 *make_sine(const struct compare_case *c, double freq, int frames)
+{
+    const int bytes = SDL_AUDIO_BITSIZE(c->src_format) / 8;
+    Uint8 *buf = SDL_malloc((size_t)frames * c->src_channels * bytes);
+
+    if (buf == NULL)
+        return NULL;
+    for (int i = 0; i < frames; i++)
+    {
+        const double x = 0.5 * sin(2.0 * M_PI * freq * i / c->src_rate);
+        for (int ch = 0; ch < c->src_channels; ch++)
+        {
+            const int n = i * c->src_channels + ch;
+            switch (c->src_format)
+            {
+            case AUDIO_U8:
+                buf[n] = (Uint8)lrint(128.0 + x * 128.0);
+                break;
+            case AUDIO_S16LSB:
+                ((Sint16 *)buf)[n] = (Sint16)lrint(x * 32768.0);
+                break;
+            case AUDIO_S32LSB:
+                ((Sint32 *)buf)[n] = (Sint32)lrint(x * 2147483648.0);
+                break;
+            default:
+                ((float *)buf)[n] = (float)x;
+                break;
+            }
+        }
+    }
+    return buf;
+}
+
+/*
+ * Least-squares fit of a*sin + b*cos + dc at freq to the first channel, and
+ * the ratio of the fitted sine's power to what is left over.
+ */
+static double sine_snr(const float *x, int frames, int channels, double freq, int rate)
+{
+    double ss = 0, cc = 0, sc = 0, s1 = 0, c1 = 0, n = 0, xs = 0, xc = 0, x1 = 0;
+
+    for (int i = COMPARE_EDGE; i < frames - COMPARE_EDGE; i++)
+    {
+        const double s = sin(2.0 * M_PI * freq * i / rate), c = cos(2.0 * M_PI * freq * i / rate);
+        const double v = x[i * channels];
+        ss += s * s, cc += c * c, sc += s * c, s1 += s, c1 += c, n += 1;
+        xs += v * s, xc += v * c, x1 += v;
+    }
+    if (n < 3)
+        return 0.0;
+
+    // solve the 3x3 normal equations by Cramer's rule
+    const double m[3][3] = {{ss, sc, s1}, {sc, cc, c1}, {s1, c1, n}};
+    const double r[3] = {xs, xc, x1};
+#define DET3(a) ((a)[0][0] * ((a)[1][1] * (a)[2][2] - (a)[1][2] * (a)[2][1]) - \
+                 (a)[0][1] * ((a)[1][0] * (a)[2][2] - (a)[1][2] * (a)[2][0]) + \
+                 (a)[0][2] * ((a)[1][0] * (a)[2][1] - (a)[1][1] * (a)[2][0]))
+    const double det = DET3(m);
+    double coef[3];
+    for (int k = 0; k < 3; k++)
+    {
+        double t[3][3];
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                t[i][j] = (j == k) ? r[i] : m[i][j];
+        coef[k] = DET3(t) / det;
+    }
+#undef DET3
+
+    double signal = 0, noise = 0;
+    for (int i = COMPARE_EDGE; i < frames - COMPARE_EDGE; i++)
+    {
+        const double s = sin(2.0 * M_PI * freq * i / rate), c = cos(2.0 * M_PI * freq * i / rate);
+        const double fit = coef[0] * s + coef[1] * c;
+        const double e = x[i * channels] - fit - coef[2];
+        signal += fit * fit;
+        noise += e * e;
+    }
+    return noise > 0 ? 10.0 * log10(signal / noise) : 200.0;
+}
+
+/*
+ * One conversion path, set up once and then run repeatedly, so the timed part
+ * is the conversion alone: no filter design, SDL_AudioCVT or SDL_AudioStream
+ * creation, or output allocation.
+ */
+struct path_run
+{
+    int path;
+    SDL_AudioCVT cvt;
+    SDL_AudioStream *stream;
+    struct converter cv;
+    Uint8 *out;
+    int out_size;
+};
+
+static void path_free(struct path_run *r)
+{
+    if (r->stream)
+        SDL_FreeAudioStream(r->stream);
+    if (r->path < CONVERT_QUALITIES)
+        converter_free(&r->cv);
+    if (r->path == PATH_CVT)
+        SDL_free(r->cvt.buf);
+    else
+        SDL_free(r->out);
+    SDL_zerop(r);
+}
+
+// returns 0, or -1; free r with path_free() either way
+static int path_setup(struct path_run *r, int path, const struct compare_case *c, int in_len)
+{
+    SDL_zerop(r);
+    r->path = path;
+    if (path == PATH_CVT)
+    {
+        if (SDL_BuildAudioCVT(&r->cvt, c->src_format, c->src_channels, c->src_rate,
+                              c->dst_format, c->dst_channels, c->dst_rate) < 0)
+            return -1;
+        if ((r->cvt.buf = SDL_malloc((size_t)in_len * r->cvt.len_mult)) == NULL)
+            return SDL_OutOfMemory();
+        return 0;
+    }
+    if (path == PATH_STREAM)
+    {
+        // the output is sized on the first run, which is not timed
+        r->stream = SDL_NewAudioStream(c->src_format, c->src_channels, c->src_rate,
+                                       c->dst_format, c->dst_channels, c->dst_rate);
+        return r->stream ? 0 : -1;
+    }
+    if (converter_init(&r->cv, c->src_format, c->src_channels, c->src_rate,
+                       c->dst_format, c->dst_channels, c->dst_rate, path) < 0)
+        return -1;
+    r->out_size = (int)converter_max_output(&r->cv, in_len);
+    if ((r->out = SDL_malloc(r->out_size)) == NULL)
+        return SDL_OutOfMemory();
+    return 0;
+}
+
+// converts all of in into r->out; returns output bytes, or -1
+static int path_convert(struct path_run *r, const Uint8 *in, int in_len)
+{
+    if (r->path == PATH_CVT)
+    {
+        // converts in place, so the input is copied in every time, as any caller has to
+        SDL_memcpy(r->cvt.buf, in, in_len);
+        r->cvt.len = in_len;
+        if (r->cvt.needed && SDL_ConvertAudio(&r->cvt) < 0)
+            return -1;
+        r->out = r->cvt.buf;
+        return r->cvt.needed ? r->cvt.len_cvt : in_len;
+    }
+
+    if (r->path == PATH_STREAM)
+    {
+        SDL_AudioStreamClear(r->stream);
+        for (int off = 0; off < in_len; off += COMPARE_STREAM_BLOCK)
+            SDL_AudioStreamPut(r->stream, in + off, SDL_min(COMPARE_STREAM_BLOCK, in_len - off));
+        SDL_AudioStreamFlush(r->stream);
+        const int len = SDL_AudioStreamAvailable(r->stream);
+        if (len > r->out_size)
+        {
+            Uint8 *out = SDL_realloc(r->out, len);
+            if (out == NULL)
+                return SDL_OutOfMemory();
+            r->out = out;
+            r->out_size = len;
+        }
+        return SDL_AudioStreamGet(r->stream, r->out, len);
+    }
+
+    converter_reset(&r->cv);
+    size_t len = converter_process(&r->cv, in, in_len, r->out);
+    len += converter_flush(&r->cv, r->out + len);
+    return (int)len;
+}
+
+int convert_compare(void)
+{
+    const double freq = SDL_GetPerformanceFrequency();
+    int ret = -1;
+
+    printf("converter kernels: %s\n", convert_select()->name);
+    printf("%-32s %-16s %10s %12s %12s\n", "case", "path", "x realtime", "SNR 997 Hz", "SNR high");
+
+    for (size_t i = 0; i < SDL_arraysize(cases); i++)
+    {
+        const struct compare_case *c = &cases[i];
+        const int frames = c->src_rate * COMPARE_SECONDS;
+        const int in_len = frames * c->src_channels * (SDL_AUDIO_BITSIZE(c->src_format) / 8);
+        // close to the top of the band the lower rate can carry
+        const double high = 0.4 * SDL_min(c->src_rate, c->dst_rate);
+        Uint8 *low_in = make_sine(c, 997.0, frames);
+        Uint8 *high_in = make_sine(c, high, frames);
+
+        if (low_in == NULL || high_in == NULL)
+        {
+            SDL_free(low_in);
+            SDL_free(high_in);
+            SDL_OutOfMemory();
+            goto done;
+        }
+
+        for (int path = 0; path < PATHS; path++)
+        {
+            const int dst_frame = c->dst_channels * (SDL_AUDIO_BITSIZE(c->dst_format) / 8);
+            double snr[2];
+            struct path_run run;
+            double secs = 0.0;
+
+            // the first run is not timed: it warms the caches and sizes the stream's output
+            int len = path_setup(&run, path, c, in_len);
+            for (int rep = 0; rep <= COMPARE_REPEATS && len >= 0; rep++)
+            {
+                const Uint64 start = SDL_GetPerformanceCounter();
+                len = path_convert(&run, low_in, in_len);
+                const double t = (SDL_GetPerformanceCounter() - start) / freq;
+                if (rep == 1 || t < secs)
+                    secs = t;
+            }
+
+            for (int k = 0; k < 2 && len >= 0; k++)
+            {
+                if (k == 1)
+                {
+                    len = path_convert(&run, high_in, in_len);
+                    if (len < 0)
+                        break;
+                }
+                const int out_frames = len / dst_frame;
+                float *f = SDL_malloc((size_t)out_frames * c->dst_channels * sizeof(float));
+                if (f == NULL)
+                {
+                    snr[k] = 0.0;
+                    continue;
+                }
+                convert_to_f32(convert_select(), c->dst_format, run.out, f, out_frames * c->dst_channels);
+                snr[k] = sine_snr(f, out_frames, c->dst_channels, k ? high : 997.0, c->dst_rate);
+                SDL_free(f);
+            }
+            path_free(&run);
+
+            if (len < 0)
+                printf("%-32s %-16s failed: %s\n", c->name, path_name(path), SDL_GetError());
+            else
+                printf("%-32s %-16s %10.0f %9.1f dB %9.1f dB\n", c->name, path_name(path),
+                       COMPARE_SECONDS / secs, snr[0], snr[1]);
+        }
+        SDL_free(low_in);
+        SDL_free(high_in);
+    }
+    ret = 0;
+
+done:
+    return ret;
+}
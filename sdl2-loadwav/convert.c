@@ -0,0 +1,801 @@
+#include <math.h>
+#include <string.h>
+
+#include "convert.h"
+
+#ifdef __SSE2__
+#define CONVERT_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__SSE2__)
+#define CONVERT_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CONVERT_NEON 1
+#include <arm_neon.h>
+#endif
+
+// largest float below 1.0: +1.0 would overflow S32
+#define BELOW_ONE 0.99999994f
+
+const char *convert_quality_names[CONVERT_QUALITIES] = {"fast", "medium", "best"};
+
+static const struct
+{
+    int taps;
+    double cutoff; // of the lower Nyquist frequency
+    double beta;   // Kaiser window
+} qualities[CONVERT_QUALITIES] = {
+    {8, 0.80, 4.0},
+    {24, 0.90, 7.0},
+    {64, 0.95, 9.5},
+};
+
+/******************************************************************************/
+/* sample kernels                                                             */
+
+static void s16_to_f32_scalar(const Sint16 *src, float *dst, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = src[i] * (1.0f / 32768.0f);
+}
+
+static void s32_to_f32_scalar(const Sint32 *src, float *dst, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = (float)src[i] * (1.0f / 2147483648.0f);
+}
+
+static void u8_to_f32_scalar(const Uint8 *src, float *dst, int n)
+{
+    for (int i = 0; i < n; i++)
+        dst[i] = (src[i] - 128) * (1.0f / 128.0f);
+}
+
+static void f32_to_s16_scalar(const float *src, Sint16 *dst, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        float x = src[i] * 32768.0f;
+        x = x < -32768.0f ? -32768.0f : x > 32767.0f ? 32767.0f : x;
+        dst[i] = (Sint16)lrintf(x);
+    }
+}
+
+static void f32_to_s32_scalar(const float *src, Sint32 *dst, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        float x = src[i];
+        x = x < -1.0f ? -1.0f : x > BELOW_ONE ? BELOW_ONE : x;
+        dst[i] = (Sint32)lrintf(x * 2147483648.0f);
+    }
+}
+
+static void f32_to_u8_scalar(const float *src, Uint8 *dst, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        float x = src[i] * 128.0f + 128.0f;
+        x = x < 0.0f ? 0.0f : x > 255.0f ? 255.0f : x;
+        dst[i] = (Uint8)lrintf(x);
+    }
+}
+
+static float dot_scalar(const float *x, const float *h, int taps)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < taps; i++)
+        sum += x[i] * h[i];
+    return sum;
+}
+
+#ifdef CONVERT_SSE2
+static void s16_to_f32_sse2(const Sint16 *src, float *dst, int n)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        // sign-extend by putting each sample in the top half and shifting back
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    s16_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+static void s32_to_f32_sse2(const Sint32 *src, float *dst, int n)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    s32_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+static void u8_to_f32_sse2(const Uint8 *src, float *dst, int n)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 128.0f);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias);
+        const __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(v, zero), bias);
+        const __m128i w[4] = {
+            _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16), _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16),
+            _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16), _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)};
+        for (int j = 0; j < 4; j++)
+            _mm_storeu_ps(dst + i + 4 * j, _mm_mul_ps(_mm_cvtepi32_ps(w[j]), scale));
+    }
+    u8_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+static void f32_to_s16_sse2(const float *src, Sint16 *dst, int n)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 lo = _mm_set1_ps(-32768.0f), hi = _mm_set1_ps(32767.0f);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        // clamp first: cvtps_epi32 turns large positive values negative
+        const __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lo), hi);
+        const __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lo), hi);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+    f32_to_s16_scalar(src + i, dst + i, n - i);
+}
+
+static void f32_to_s32_sse2(const float *src, Sint32 *dst, int n)
+{
+    const __m128 scale = _mm_set1_ps(2147483648.0f);
+    const __m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(BELOW_ONE);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lo), hi);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_cvtps_epi32(_mm_mul_ps(x, scale)));
+    }
+    f32_to_s32_scalar(src + i, dst + i, n - i);
+}
+
+static void f32_to_u8_sse2(const float *src, Uint8 *dst, int n)
+{
+    const __m128 scale = _mm_set1_ps(128.0f), bias = _mm_set1_ps(128.0f);
+    const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(255.0f);
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i w[4];
+        for (int j = 0; j < 4; j++)
+        {
+            const __m128 x = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4 * j), scale), bias);
+            w[j] = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(x, lo), hi));
+        }
+        const __m128i a = _mm_packs_epi32(w[0], w[1]), b = _mm_packs_epi32(w[2], w[3]);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(a, b));
+    }
+    f32_to_u8_scalar(src + i, dst + i, n - i);
+}
+
+static float dot_sse2(const float *x, const float *h, int taps)
+{
+    __m128 a = _mm_setzero_ps(), b = _mm_setzero_ps();
+
+    for (int i = 0; i < taps; i += 8)
+    {
+        a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(h + i)));
+        b = _mm_add_ps(b, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(h + i + 4)));
+    }
+    a = _mm_add_ps(a, b);
+    a = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    a = _mm_add_ss(a, _mm_shuffle_ps(a, a, 1));
+    return _mm_cvtss_f32(a);
+}
+#endif
+
+#ifdef CONVERT_AVX2
+__attribute__((target("avx2"))) static void s16_to_f32_avx2(const Sint16 *src, float *dst, int n)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    s16_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void s32_to_f32_avx2(const Sint32 *src, float *dst, int n)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    s32_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void u8_to_f32_avx2(const Uint8 *src, float *dst, int n)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 128.0f);
+    const __m256i bias = _mm256_set1_epi32(128);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(v, bias)), scale));
+    }
+    u8_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void f32_to_s16_avx2(const float *src, Sint16 *dst, int n)
+{
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    const __m256 lo = _mm256_set1_ps(-32768.0f), hi = _mm256_set1_ps(32767.0f);
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lo), hi);
+        const __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), lo), hi);
+        // packs works per 128-bit lane: a0 b0 a1 b1, put the quarters back in order
+        const __m256i p = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(p, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    f32_to_s16_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void f32_to_s32_avx2(const float *src, Sint32 *dst, int n)
+{
+    const __m256 scale = _mm256_set1_ps(2147483648.0f);
+    const __m256 lo = _mm256_set1_ps(-1.0f), hi = _mm256_set1_ps(BELOW_ONE);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), lo), hi);
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_cvtps_epi32(_mm256_mul_ps(x, scale)));
+    }
+    f32_to_s32_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx2"))) static float dot_avx2(const float *x, const float *h, int taps)
+{
+    __m256 a = _mm256_setzero_ps();
+
+    for (int i = 0; i < taps; i += 8)
+        a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(h + i)));
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+#endif
+
+#ifdef CONVERT_NEON
+// round to nearest, halves to even, like cvtps_epi32/lrintf, so the output matches the scalar kernel bit for bit.
+// ARMv7 can only convert by truncating: below 2^23, adding and taking away 2^23 (with x's sign) rounds x to a
+// whole number, since NEON arithmetic always rounds to nearest even; from 2^23 up x is whole already.
+static inline int32x4_t neon_round(float32x4_t x)
+{
+#ifdef __aarch64__
+    return vcvtnq_s32_f32(x);
+#else
+    const uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x80000000));
+    const float32x4_t magic = vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(vdupq_n_f32(8388608.0f)), sign));
+    const float32x4_t whole = vsubq_f32(vaddq_f32(x, magic), magic);
+    const uint32x4_t big = vcageq_f32(x, vdupq_n_f32(8388608.0f));
+    return vcvtq_s32_f32(vbslq_f32(big, x, whole));
+#endif
+}
+
+static void s16_to_f32_neon(const Sint16 *src, float *dst, int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const int16x8_t v = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / 32768.0f));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / 32768.0f));
+    }
+    s16_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+static void s32_to_f32_neon(const Sint32 *src, float *dst, int n)
+{
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src + i)), 1.0f / 2147483648.0f));
+    s32_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+static void u8_to_f32_neon(const Uint8 *src, float *dst, int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const int16x8_t v = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src + i))), vdupq_n_s16(128));
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / 128.0f));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / 128.0f));
+    }
+    u8_to_f32_scalar(src + i, dst + i, n - i);
+}
+
+static void f32_to_s16_neon(const float *src, Sint16 *dst, int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        // vqmovn saturates, the float clamp keeps the conversion in range
+        const float32x4_t lo = vdupq_n_f32(-32768.0f), hi = vdupq_n_f32(32767.0f);
+        const float32x4_t a = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(src + i), 32768.0f), lo), hi);
+        const float32x4_t b = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(src + i + 4), 32768.0f), lo), hi);
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(neon_round(a)), vqmovn_s32(neon_round(b))));
+    }
+    f32_to_s16_scalar(src + i, dst + i, n - i);
+}
+
+static void f32_to_s32_neon(const float *src, Sint32 *dst, int n)
+{
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        const float32x4_t x = vminq_f32(vmaxq_f32(vld1q_f32(src + i), vdupq_n_f32(-1.0f)), vdupq_n_f32(BELOW_ONE));
+        vst1q_s32(dst + i, neon_round(vmulq_n_f32(x, 2147483648.0f)));
+    }
+    f32_to_s32_scalar(src + i, dst + i, n - i);
+}
+
+static void f32_to_u8_neon(const float *src, Uint8 *dst, int n)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const float32x4_t lo = vdupq_n_f32(0.0f), hi = vdupq_n_f32(255.0f);
+        const float32x4_t a = vminq_f32(vmaxq_f32(vmlaq_n_f32(vdupq_n_f32(128.0f), vld1q_f32(src + i), 128.0f), lo), hi);
+        const float32x4_t b = vminq_f32(vmaxq_f32(vmlaq_n_f32(vdupq_n_f32(128.0f), vld1q_f32(src + i + 4), 128.0f), lo), hi);
+        const int16x8_t w = vcombine_s16(vqmovn_s32(neon_round(a)), vqmovn_s32(neon_round(b)));
+        vst1_u8(dst + i, vqmovun_s16(w));
+    }
+    f32_to_u8_scalar(src + i, dst + i, n - i);
+}
+
+static float dot_neon(const float *x, const float *h, int taps)
+{
+    float32x4_t a = vdupq_n_f32(0.0f), b = vdupq_n_f32(0.0f);
+
+    for (int i = 0; i < taps; i += 8)
+    {
+        a = vmlaq_f32(a, vld1q_f32(x + i), vld1q_f32(h + i));
+        b = vmlaq_f32(b, vld1q_f32(x + i + 4), vld1q_f32(h + i + 4));
+    }
+    a = vaddq_f32(a, b);
+    float32x2_t s = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+#endif
+
+// best first; the scalar kernels must stay last
+const struct convert_kernels convert_kernels[] = {
+#ifdef CONVERT_AVX2
+    {"avx2", SDL_HasAVX2, s16_to_f32_avx2, s32_to_f32_avx2, u8_to_f32_avx2,
+     f32_to_s16_avx2, f32_to_s32_avx2, f32_to_u8_sse2, dot_avx2},
+#endif
+#ifdef CONVERT_SSE2
+    {"sse2", SDL_HasSSE2, s16_to_f32_sse2, s32_to_f32_sse2, u8_to_f32_sse2,
+     f32_to_s16_sse2, f32_to_s32_sse2, f32_to_u8_sse2, dot_sse2},
+#endif
+#ifdef CONVERT_NEON
+    {"neon", SDL_HasNEON, s16_to_f32_neon, s32_to_f32_neon, u8_to_f32_neon,
+     f32_to_s16_neon, f32_to_s32_neon, f32_to_u8_neon, dot_neon},
+#endif
+    {"scalar", NULL, s16_to_f32_scalar, s32_to_f32_scalar, u8_to_f32_scalar,
+     f32_to_s16_scalar, f32_to_s32_scalar, f32_to_u8_scalar, dot_scalar},
+};
+
+const int convert_kernel_count = sizeof(convert_kernels) / sizeof(convert_kernels[0]);
+
+const struct convert_kernels *convert_select(void)
+{
+    for (int i = 0; i < convert_kernel_count; i++)
+        if (convert_kernels[i].supported == NULL || convert_kernels[i].supported())
+            return &convert_kernels[i];
+    return &convert_kernels[convert_kernel_count - 1];
+}
+
+void convert_to_f32(const struct convert_kernels *k, SDL_AudioFormat format, const void *src,
+                    float *dst, int n)
+{
+    switch (format)
+    {
+    case AUDIO_U8:
+        k->u8_to_f32(src, dst, n);
+        break;
+    case AUDIO_S16LSB:
+        k->s16_to_f32(src, dst, n);
+        break;
+    case AUDIO_S32LSB:
+        k->s32_to_f32(src, dst, n);
+        break;
+    default:
+        memcpy(dst, src, n * sizeof(float));
+        break;
+    }
+}
+
+static void convert_from_f32(const struct convert_kernels *k, SDL_AudioFormat format, const float *src,
+                             void *dst, int n)
+{
+    switch (format)
+    {
+    case AUDIO_U8:
+        k->f32_to_u8(src, dst, n);
+        break;
+    case AUDIO_S16LSB:
+        k->f32_to_s16(src, dst, n);
+        break;
+    case AUDIO_S32LSB:
+        k->f32_to_s32(src, dst, n);
+        break;
+    default:
+        memcpy(dst, src, n * sizeof(float));
+        break;
+    }
+}
+
+/******************************************************************************/
+/* channel mixing                                                             */
+
+/*
+ * Mono goes to every output channel and everything goes to mono as the
+ * average.  Surround layouts (SDL order: FL FR FC LFE BL BR SL SR) fold down
+ * to stereo with the center and surrounds at -3 dB, normalized so a full
+ * scale signal on every channel does not clip.  Any other pair copies the
+ * channels both sides have and silences the rest.
+ */
+static void mix_channels(const float *src, int in, float *dst, int out, int frames)
+{
+    if (in == out)
+    {
+        memcpy(dst, src, (size_t)frames * in * sizeof(float));
+    }
+    else if (in == 1)
+    {
+        for (int i = 0; i < frames; i++)
+            for (int c = 0; c < out; c++)
+                dst[i * out + c] = src[i];
+    }
+    else if (out == 1)
+    {
+        for (int i = 0; i < frames; i++)
+        {
+            float sum = 0.0f;
+            for (int c = 0; c < in; c++)
+                sum += src[i * in + c];
+            dst[i] = sum / in;
+        }
+    }
+    else if (out == 2 && in > 2)
+    {
+        // per input channel: weight into left, weight into right
+        static const float fold[CONVERT_MAX_CHANNELS][2] = {
+            {1.0f, 0.0f}, {0.0f, 1.0f}, {0.7071f, 0.7071f}, {0.0f, 0.0f},
+            {0.7071f, 0.0f}, {0.0f, 0.7071f}, {0.7071f, 0.0f}, {0.0f, 0.7071f}};
+        float norm = 0.0f;
+        for (int c = 0; c < in; c++)
+            norm += fold[c][0];
+        for (int i = 0; i < frames; i++)
+        {
+            float l = 0.0f, r = 0.0f;
+            for (int c = 0; c < in; c++)
+            {
+                l += src[i * in + c] * fold[c][0];
+                r += src[i * in + c] * fold[c][1];
+            }
+            dst[2 * i] = l / norm;
+            dst[2 * i + 1] = r / norm;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < frames; i++)
+            for (int c = 0; c < out; c++)
+                dst[i * out + c] = (c < in) ? src[i * in + c] : 0.0f;
+    }
+}
+
+/******************************************************************************/
+/* resampler                                                                  */
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+
+    for (int k = 1; k < 32; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static Uint32 gcd(Uint32 a, Uint32 b)
+{
+    while (b)
+    {
+        Uint32 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/*
+ * Phase p is an output that lies p / phases of an input frame after the
+ * center frame; tap t multiplies hist[center - taps / 2 + 1 + t].  Each
+ * phase is normalized to unity gain at DC.
+ */
+static void design_filter(struct converter *cv, enum convert_quality quality)
+{
+    const double ratio = (double)cv->dst_rate / cv->src_rate;
+    const double cutoff = qualities[quality].cutoff * (ratio < 1.0 ? ratio : 1.0);
+    const double beta = qualities[quality].beta;
+    const double half = cv->taps / 2.0;
+
+    for (int p = 0; p < cv->phases; p++)
+    {
+        float *h = cv->filter + (size_t)p * cv->taps;
+        const double frac = (double)p / cv->phases;
+        double sum = 0.0;
+
+        for (int t = 0; t < cv->taps; t++)
+        {
+            const double d = (t - cv->taps / 2 + 1) - frac;
+            const double x = M_PI * cutoff * d;
+            const double sinc = (d == 0.0) ? 1.0 : sin(x) / x;
+            const double w = d / half;
+            const double window = (fabs(w) >= 1.0) ? 0.0 : bessel_i0(beta * sqrt(1.0 - w * w)) / bessel_i0(beta);
+            h[t] = (float)(cutoff * sinc * window);
+            sum += h[t];
+        }
+        for (int t = 0; t < cv->taps; t++)
+            h[t] = (float)(h[t] / sum);
+    }
+}
+
+// interleaved frames in, as many interleaved outputs as the history allows
+static int resample(struct converter *cv, const float *src, int frames, float *dst)
+{
+    const int channels = cv->dst_channels;
+    int out = 0;
+
+    for (int c = 0; c < channels; c++)
+        for (int i = 0; i < frames; i++)
+            cv->hist[c][cv->hist_len + i] = src[i * channels + c];
+    cv->hist_len += frames;
+
+    while (cv->pos + cv->taps / 2 < cv->hist_len)
+    {
+        const Uint32 phase = (cv->phases == (int)cv->den) ? cv->frac : (Uint32)((Uint64)cv->frac * cv->phases / cv->den);
+        const float *h = cv->filter + (size_t)phase * cv->taps;
+        const int first = cv->pos - cv->taps / 2 + 1;
+
+        for (int c = 0; c < channels; c++)
+            dst[out * channels + c] = cv->k->dot(cv->hist[c] + first, h, cv->taps);
+        out++;
+
+        cv->frac += cv->num;
+        cv->pos += cv->frac / cv->den;
+        cv->frac %= cv->den;
+    }
+
+    // keep what the next outputs still need
+    int drop = cv->pos - cv->taps / 2 + 1;
+    if (drop > cv->hist_len)
+        drop = cv->hist_len; // downsampling can step past the end of the block
+    if (drop > 0)
+    {
+        for (int c = 0; c < channels; c++)
+            memmove(cv->hist[c], cv->hist[c] + drop, (cv->hist_len - drop) * sizeof(float));
+        cv->hist_len -= drop;
+        cv->pos -= drop;
+    }
+    return out;
+}
+
+/******************************************************************************/
+/* converter                                                                  */
+
+static int format_supported(SDL_AudioFormat format)
+{
+    return format == AUDIO_U8 || format == AUDIO_S16LSB || format == AUDIO_S32LSB || format == AUDIO_F32LSB;
+}
+
+int converter_init(struct converter *cv, SDL_AudioFormat src_format, int src_channels, int src_rate,
+                   SDL_AudioFormat dst_format, int dst_channels, int dst_rate,
+                   enum convert_quality quality)
+{
+    SDL_zerop(cv);
+    if (!format_supported(src_format) || !format_supported(dst_format))
+        return SDL_SetError("converter: format 0x%04x -> 0x%04x is not supported", src_format, dst_format);
+    if (src_channels < 1 || src_channels > CONVERT_MAX_CHANNELS ||
+        dst_channels < 1 || dst_channels > CONVERT_MAX_CHANNELS || src_rate <= 0 || dst_rate <= 0)
+        return SDL_SetError("converter: %d -> %d channels, %d -> %d Hz is not supported",
+                            src_channels, dst_channels, src_rate, dst_rate);
+
+    cv->src_format = src_format;
+    cv->dst_format = dst_format;
+    cv->src_channels = src_channels;
+    cv->dst_channels = dst_channels;
+    cv->src_rate = src_rate;
+    cv->dst_rate = dst_rate;
+    cv->src_frame = SDL_AUDIO_BITSIZE(src_format) / 8 * src_channels;
+    cv->dst_frame = SDL_AUDIO_BITSIZE(dst_format) / 8 * dst_channels;
+    cv->k = convert_select();
+
+    // the resampler can produce a few more frames per block than it takes in
+    const int out_frames = (int)((Sint64)CONVERT_BLOCK * dst_rate / src_rate) + 2;
+    cv->in_f32 = SDL_malloc((size_t)CONVERT_BLOCK * src_channels * sizeof(float));
+    cv->mix_f32 = SDL_malloc((size_t)CONVERT_BLOCK * dst_channels * sizeof(float));
+    cv->out_f32 = SDL_malloc((size_t)SDL_max(out_frames, CONVERT_BLOCK) * dst_channels * sizeof(float));
+    if (!cv->in_f32 || !cv->mix_f32 || !cv->out_f32)
+    {
+        converter_free(cv);
+        return SDL_OutOfMemory();
+    }
+
+    if (src_rate != dst_rate)
+    {
+        const Uint32 g = gcd(src_rate, dst_rate);
+        cv->num = src_rate / g;
+        cv->den = dst_rate / g;
+        // downsampling narrows the passband: stretch the filter to keep its shape
+        cv->taps = qualities[quality].taps * ((cv->num + cv->den - 1) / cv->den);
+        if (cv->taps > CONVERT_MAX_TAPS)
+            cv->taps = CONVERT_MAX_TAPS;
+        cv->phases = (cv->den <= CONVERT_MAX_PHASES) ? (int)cv->den : CONVERT_MAX_PHASES;
+        cv->filter = SDL_malloc((size_t)cv->phases * cv->taps * sizeof(float));
+        for (int c = 0; c < dst_channels; c++)
+            cv->hist[c] = SDL_calloc(cv->taps + CONVERT_BLOCK, sizeof(float));
+        for (int c = 0; c < dst_channels; c++)
+        {
+            if (!cv->filter || !cv->hist[c])
+            {
+                converter_free(cv);
+                return SDL_OutOfMemory();
+            }
+        }
+        design_filter(cv, quality);
+        // zeros before the first frame so that output 0 is centered on input 0
+        cv->hist_len = cv->taps / 2 - 1;
+        cv->pos = cv->hist_len;
+    }
+    return 0;
+}
+
+void converter_free(struct converter *cv)
+{
+    SDL_free(cv->in_f32);
+    SDL_free(cv->mix_f32);
+    SDL_free(cv->out_f32);
+    SDL_free(cv->filter);
+    for (int c = 0; c < CONVERT_MAX_CHANNELS; c++)
+        SDL_free(cv->hist[c]);
+    SDL_zerop(cv);
+}
+
+void converter_reset(struct converter *cv)
+{
+    cv->carry_len = 0;
+    if (!cv->filter)
+        return;
+    cv->hist_len = cv->taps / 2 - 1;
+    cv->pos = cv->hist_len;
+    cv->frac = 0;
+    for (int c = 0; c < cv->dst_channels; c++)
+        memset(cv->hist[c], 0, cv->hist_len * sizeof(float));
+}
+
+size_t converter_max_output(const struct converter *cv, size_t in_len)
+{
+    const size_t frames = in_len / cv->src_frame + 1;
+    const size_t blocks = frames / CONVERT_BLOCK + 1;
+    // two extra frames per block for rounding, plus the flushed tail
+    const size_t out = (size_t)((double)frames * cv->dst_rate / cv->src_rate) + 2 * blocks + cv->taps;
+
+    return out * cv->dst_frame;
+}
+
+// frames whole source frames from src
+static size_t convert_block(struct converter *cv, const Uint8 *src, int frames, Uint8 *out)
+{
+    const float *mixed = cv->mix_f32;
+    int out_frames = frames;
+
+    convert_to_f32(cv->k, cv->src_format, src, cv->in_f32, frames * cv->src_channels);
+    mix_channels(cv->in_f32, cv->src_channels, cv->mix_f32, cv->dst_channels, frames);
+    if (cv->filter)
+    {
+        out_frames = resample(cv, cv->mix_f32, frames, cv->out_f32);
+        mixed = cv->out_f32;
+    }
+    convert_from_f32(cv->k, cv->dst_format, mixed, out, out_frames * cv->dst_channels);
+    return (size_t)out_frames * cv->dst_frame;
+}
+
+size_t converter_process(struct converter *cv, const Uint8 *in, size_t in_len, Uint8 *out)
+{
+    size_t written = 0;
+
+    // complete the partial frame left over from the last call
+    if (cv->carry_len > 0)
+    {
+        size_t n = cv->src_frame - cv->carry_len;
+        if (n > in_len)
+            n = in_len;
+        memcpy(cv->carry + cv->carry_len, in, n);
+        cv->carry_len += n;
+        in += n;
+        in_len -= n;
+        if (cv->carry_len < cv->src_frame)
+            return 0;
+        written += convert_block(cv, cv->carry, 1, out);
+        cv->carry_len = 0;
+    }
+
+    while (in_len >= (size_t)cv->src_frame)
+    {
+        size_t frames = in_len / cv->src_frame;
+        if (frames > CONVERT_BLOCK)
+            frames = CONVERT_BLOCK;
+        written += convert_block(cv, in, (int)frames, out + written);
+        in += frames * cv->src_frame;
+        in_len -= frames * cv->src_frame;
+    }
+
+    memcpy(cv->carry, in, in_len);
+    cv->carry_len = (int)in_len;
+    return written;
+}
+
+size_t converter_flush(struct converter *cv, Uint8 *out)
+{
+    if (!cv->filter)
+        return 0;
+
+    // enough silence to bring the last input frame to the center of the filter
+    const int frames = cv->taps / 2;
+    for (int i = 0; i < frames * cv->dst_channels; i++)
+        cv->mix_f32[i] = 0.0f;
+    const int out_frames = resample(cv, cv->mix_f32, frames, cv->out_f32);
+    convert_from_f32(cv->k, cv->dst_format, cv->out_f32, out, out_frames * cv->dst_channels);
+    return (size_t)out_frames * cv->dst_frame;
+}
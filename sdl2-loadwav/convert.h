@@ -0,0 +1,106 @@
+#ifndef CONVERT_H
+#define CONVERT_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Audio format conversion and resampling.
+ *
+ * A converter turns bytes in one (format, channels, rate) into another, a
+ * block of up to CONVERT_BLOCK frames at a time:
+ *
+ *   source format -> float -> channel mix -> polyphase resampler -> float
+ *   -> destination format
+ *
+ * U8, S16LSB, S32LSB and F32LSB are supported on both sides.  The sample
+ * conversions and the resampler's dot product have SSE2, AVX2 and NEON
+ * kernels; convert_select() picks the best one the CPU supports.
+ *
+ * The resampler is a windowed-sinc polyphase filter.  The rate ratio is
+ * reduced to num/den and every output phase gets its own precomputed filter
+ * when den <= CONVERT_MAX_PHASES, otherwise phases are quantized.  It keeps
+ * its history between calls, so a file can be converted in one go or block
+ * by block with identical results; converter_flush() emits the tail.
+ */
+#define CONVERT_BLOCK 1024
+#define CONVERT_MAX_CHANNELS 8
+#define CONVERT_MAX_PHASES 1024
+#define CONVERT_MAX_TAPS 256
+
+enum convert_quality
+{
+    CONVERT_FAST,   // 8 taps, times the decimation factor when downsampling
+    CONVERT_MEDIUM, // 24 taps
+    CONVERT_BEST,   // 64 taps
+    CONVERT_QUALITIES
+};
+
+extern const char *convert_quality_names[CONVERT_QUALITIES];
+
+struct convert_kernels
+{
+    const char *name;
+    SDL_bool (*supported)(void); // NULL: always available
+    void (*s16_to_f32)(const Sint16 *src, float *dst, int n);
+    void (*s32_to_f32)(const Sint32 *src, float *dst, int n);
+    void (*u8_to_f32)(const Uint8 *src, float *dst, int n);
+    void (*f32_to_s16)(const float *src, Sint16 *dst, int n);
+    void (*f32_to_s32)(const float *src, Sint32 *dst, int n);
+    void (*f32_to_u8)(const float *src, Uint8 *dst, int n);
+    float (*dot)(const float *x, const float *h, int taps); // taps is a multiple of 8
+};
+
+struct converter
+{
+    SDL_AudioFormat src_format, dst_format;
+    int src_channels, dst_channels;
+    int src_rate, dst_rate;
+    int src_frame, dst_frame; // bytes
+    const struct convert_kernels *k;
+
+    // resampler, filter == NULL when the rates match
+    int taps;
+    int phases;
+    Uint32 num, den; // input frames advanced per output frame, as a fraction
+    float *filter;   // phases x taps
+    float *hist[CONVERT_MAX_CHANNELS]; // planar input history
+    int hist_len;    // valid frames in each hist
+    int pos;         // hist index of the next output's center frame
+    Uint32 frac;     // and its fractional part, in 1/den
+
+    // scratch, CONVERT_BLOCK frames each
+    float *in_f32;
+    float *mix_f32;
+    float *out_f32;
+    Uint8 carry[CONVERT_MAX_CHANNELS * 4]; // partial source frame left over
+    int carry_len;
+};
+
+/* compiled-in kernels, best first, scalar last */
+extern const struct convert_kernels convert_kernels[];
+extern const int convert_kernel_count;
+
+const struct convert_kernels *convert_select(void);
+
+/* returns 0 on success, -1 (see SDL_GetError()) for unsupported formats */
+int converter_init(struct converter *cv, SDL_AudioFormat src_format, int src_channels, int src_rate,
+                   SDL_AudioFormat dst_format, int dst_channels, int dst_rate,
+                   enum convert_quality quality);
+void converter_free(struct converter *cv);
+/* forget all input so far, to convert another stream with the same settings; no allocation */
+void converter_reset(struct converter *cv);
+/* most bytes converter_process() or converter_flush() write for in_len bytes */
+size_t converter_max_output(const struct converter *cv, size_t in_len);
+/* convert in_len bytes (any split, even mid-frame) into out; returns bytes written */
+size_t converter_process(struct converter *cv, const Uint8 *in, size_t in_len, Uint8 *out);
+/* end of input: write what the resampler still holds */
+size_t converter_flush(struct converter *cv, Uint8 *out);
+
+/* any supported format to float, for analysis */
+void convert_to_f32(const struct convert_kernels *k, SDL_AudioFormat format, const void *src,
+                    float *dst, int n);
+
+/* -C: throughput and quality against SDL_AudioCVT and SDL_AudioStream, in compare.c */
+int convert_compare(void);
+
+#endif /* CONVERT_H */
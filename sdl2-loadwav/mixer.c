@@ -0,0 +1,200 @@
+#include <string.h>
+
+#include "mixer.h"
+
+#ifdef __SSE2__
+#define MIXER_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__SSE2__)
+#define MIXER_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MIXER_NEON 1
+#include <arm_neon.h>
+#endif
+
+static void mix_scalar(Sint16 *dst, const Sint16 *src, int n, Sint16 gain)
+{
+    for (int i = 0; i < n; i++)
+    {
+        const int v = dst[i] + ((src[i] * gain + 0x4000) >> 15);
+        dst[i] = v < -32768 ? -32768 : v > 32767 ? 32767 : v;
+    }
+}
+
+#ifdef MIXER_SSE2
+static void mix_sse2(Sint16 *dst, const Sint16 *src, int n, Sint16 gain)
+{
+    const __m128i g = _mm_set1_epi16(gain);
+    const __m128i round = _mm_set1_epi32(0x4000);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        // no mulhrs before SSSE3: widen the products to 32 bits and round by hand
+        const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128i lo = _mm_mullo_epi16(s, g), hi = _mm_mulhi_epi16(s, g);
+        const __m128i a = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 15);
+        const __m128i b = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 15);
+        const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epi16(d, _mm_packs_epi32(a, b)));
+    }
+    mix_scalar(dst + i, src + i, n - i, gain);
+}
+#endif
+
+#ifdef MIXER_AVX2
+__attribute__((target("avx2"))) static void mix_avx2(Sint16 *dst, const Sint16 *src, int n, Sint16 gain)
+{
+    const __m256i g = _mm256_set1_epi16(gain);
+    int i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        // mulhrs is (s * g + 0x4000) >> 15, exactly the scalar rounding
+        const __m256i s = _mm256_mulhrs_epi16(_mm256_loadu_si256((const __m256i *)(src + i)), g);
+        const __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_adds_epi16(d, s));
+    }
+    mix_scalar(dst + i, src + i, n - i, gain);
+}
+#endif
+
+#ifdef MIXER_NEON
+static void mix_neon(Sint16 *dst, const Sint16 *src, int n, Sint16 gain)
+{
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        // vqrdmulh is (2 * s * g + 0x8000) >> 16, the same as the scalar rounding
+        const int16x8_t s = vqrdmulhq_n_s16(vld1q_s16(src + i), gain);
+        vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), s));
+    }
+    mix_scalar(dst + i, src + i, n - i, gain);
+}
+#endif
+
+// best first; the scalar kernel must stay last
+const struct mixer_kernel mixer_kernels[] = {
+#ifdef MIXER_AVX2
+    {"avx2", SDL_HasAVX2, mix_avx2},
+#endif
+#ifdef MIXER_SSE2
+    {"sse2", SDL_HasSSE2, mix_sse2},
+#endif
+#ifdef MIXER_NEON
+    {"neon", SDL_HasNEON, mix_neon},
+#endif
+    {"scalar", NULL, mix_scalar},
+};
+
+const int mixer_kernel_count = sizeof(mixer_kernels) / sizeof(mixer_kernels[0]);
+
+void mixer_init(struct mixer *m, const struct bank *bank)
+{
+    SDL_zerop(m);
+    m->bank = bank;
+    m->k = &mixer_kernels[mixer_kernel_count - 1];
+    for (int i = 0; i < mixer_kernel_count; i++)
+    {
+        if (mixer_kernels[i].supported == NULL || mixer_kernels[i].supported())
+        {
+            m->k = &mixer_kernels[i];
+            break;
+        }
+    }
+    atomic_init(&m->head, 0);
+    atomic_init(&m->tail, 0);
+    atomic_init(&m->dropped, 0);
+    atomic_init(&m->active, 0);
+    atomic_init(&m->stolen, 0);
+    trace_init(&m->starts);
+}
+
+int mixer_trigger(struct mixer *m, int sound, Sint16 gain)
+{
+    const unsigned head = atomic_load_explicit(&m->head, memory_order_relaxed);
+
+    if (sound < 0 || sound >= m->bank->count)
+        return SDL_SetError("mixer: no sound %d in the bank", sound);
+    if (head - atomic_load_explicit(&m->tail, memory_order_acquire) == MIXER_COMMANDS)
+    {
+        atomic_fetch_add_explicit(&m->dropped, 1, memory_order_relaxed);
+        return SDL_SetError("mixer: command queue full");
+    }
+    m->commands[head % MIXER_COMMANDS].sound = sound;
+    m->commands[head % MIXER_COMMANDS].gain = gain;
+    m->commands[head % MIXER_COMMANDS].issued = SDL_GetPerformanceCounter();
+    atomic_store_explicit(&m->head, head + 1, memory_order_release);
+    return 0;
+}
+
+static struct mixer_voice *free_voice(struct mixer *m)
+{
+    struct mixer_voice *oldest = &m->voices[0];
+
+    for (int i = 0; i < MIXER_VOICES; i++)
+    {
+        if (m->voices[i].samples == NULL)
+            return &m->voices[i];
+        if (m->voices[i].started < oldest->started)
+            oldest = &m->voices[i];
+    }
+    atomic_fetch_add_explicit(&m->stolen, 1, memory_order_relaxed);
+    return oldest;
+}
+
+void mixer_mix(struct mixer *m, Sint16 *out, int n)
+{
+    const Uint64 now = SDL_GetPerformanceCounter();
+    unsigned tail = atomic_load_explicit(&m->tail, memory_order_relaxed);
+    const unsigned head = atomic_load_explicit(&m->head, memory_order_acquire);
+    Uint32 active = 0, mixed = 0;
+
+    m->callbacks++;
+    for (; tail != head; tail++)
+    {
+        const struct mixer_command *c = &m->commands[tail % MIXER_COMMANDS];
+        const struct bank_entry *e = &m->bank->index[c->sound];
+        struct mixer_voice *v = free_voice(m);
+        struct trace_record r;
+
+        v->samples = bank_samples(m->bank, c->sound);
+        v->pos = 0;
+        v->len = e->frames * m->bank->channels;
+        v->gain = c->gain;
+        v->started = m->callbacks;
+
+        r.timestamp = c->issued;
+        r.duration = now - c->issued;
+        r.issued = "trigger";
+        r.event_count = c->sound;
+        r.len = v - m->voices;
+        r.loaded_len = m->callbacks;
+        trace_write(&m->starts, &r);
+    }
+    atomic_store_explicit(&m->tail, tail, memory_order_release);
+
+    memset(out, 0, n * sizeof(Sint16));
+    for (int i = 0; i < MIXER_VOICES; i++)
+    {
+        struct mixer_voice *v = &m->voices[i];
+        if (v->samples == NULL)
+            continue;
+
+        const int k = SDL_min((Uint32)n, v->len - v->pos);
+        m->k->mix(out, v->samples + v->pos, k, v->gain);
+        v->pos += k;
+        mixed++;
+        if (v->pos == v->len)
+            v->samples = NULL;
+        else
+            active++;
+    }
+    if (mixed > m->peak_voices)
+        m->peak_voices = mixed;
+    atomic_store_explicit(&m->active, active, memory_order_relaxed);
+}
@@ -0,0 +1,85 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stdatomic.h>
+#include <SDL2/SDL.h>
+
+#include "bank.h"
+#include "trace.h"
+
+/*
+ * Multi-voice mixer for a sound bank.
+ *
+ * Other threads trigger sounds with mixer_trigger(), which only writes a
+ * command into a single-producer/single-consumer ring.  The audio callback
+ * calls mixer_mix(): it takes the pending commands, starts their voices at
+ * the beginning of the buffer it is about to fill, and adds every active
+ * voice with its gain using saturating S16 arithmetic.  Nothing on the
+ * audio thread allocates, locks or waits, so a trigger is heard one buffer
+ * after the callback that picks it up.
+ *
+ * When all voices are busy, the one that has played longest is replaced.
+ */
+#define MIXER_VOICES 32
+#define MIXER_COMMANDS 256 // a power of two
+
+#define MIXER_UNITY 32767 // gain, Q15
+
+struct mixer_kernel
+{
+    const char *name;
+    SDL_bool (*supported)(void); // NULL: always available
+    // dst[i] = saturate(dst[i] + src[i] * gain / 32768), rounded
+    void (*mix)(Sint16 *dst, const Sint16 *src, int n, Sint16 gain);
+};
+
+struct mixer_command
+{
+    Uint16 sound;
+    Sint16 gain;
+    Uint64 issued; // SDL_GetPerformanceCounter() in mixer_trigger()
+};
+
+struct mixer_voice
+{
+    const Sint16 *samples; // NULL: free
+    Uint32 pos, len;       // samples
+    Sint16 gain;
+    Uint32 started;        // callback count when started
+};
+
+struct mixer
+{
+    const struct bank *bank;
+    const struct mixer_kernel *k;
+
+    // written by mixer_trigger()
+    struct mixer_command commands[MIXER_COMMANDS];
+    atomic_uint head;
+    atomic_uint dropped; // the ring was full
+
+    // written by mixer_mix()
+    atomic_uint tail;
+    struct mixer_voice voices[MIXER_VOICES];
+    Uint32 callbacks;
+    atomic_uint active; // voices playing after the last callback
+    atomic_uint stolen;
+    Uint32 peak_voices;
+
+    /*
+     * One record per started voice: timestamp is when it was triggered,
+     * duration the wait until the callback that mixed its first sample.
+     */
+    struct trace starts;
+};
+
+extern const struct mixer_kernel mixer_kernels[];
+extern const int mixer_kernel_count;
+
+void mixer_init(struct mixer *m, const struct bank *bank);
+/* any one thread: returns 0, or -1 if the command ring is full */
+int mixer_trigger(struct mixer *m, int sound, Sint16 gain);
+/* audio thread: fill out with n samples */
+void mixer_mix(struct mixer *m, Sint16 *out, int n);
+
+#endif /* MIXER_H */
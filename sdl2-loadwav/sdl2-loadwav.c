@@ -1,8 +1,19 @@
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <unistd.h>
+#include <sys/resource.h>
 #include <SDL2/SDL.h>
 
+#include "bank.h"
+#include "batch.h"
+#include "convert.h"
+#include "mixer.h"
+#include "stream.h"
+#include "trace.h"
+#include "wav.h"
+
 #define DEFAULT_AUDIO_PATH "Cuica-1.wav"
 
 struct AudioSpecUserdata_t
@@ -13,10 +24,89 @@ struct AudioSpecUserdata_t
     Uint8 *buffer;
     Uint32 buffer_len;
     Uint32 loaded_len;
+    struct wav_stream *stream; // streaming mode: read from here instead of buffer
+    struct converter *convert; // streaming mode: the device wants another format
+    Uint8 *convert_in;         // one block read from stream
+    Uint8 *convert_out;        // its converted bytes not played yet
+    Uint32 convert_out_len;
+    Uint32 convert_out_pos;
+    int convert_flushed;
+    Uint8 silence;
 };
 
 static int Quit = 0;
 
+// startup measurements, the first callback is stamped from the audio thread
+static Uint64 start_counter;
+static Uint64 first_callback_counter;
+
+static double ms_since_start(Uint64 counter)
+{
+    return (double)(counter - start_counter) * 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+// the callbacks only record what they did, the main loop prints it
+static struct trace callback_trace;
+static struct trace_histogram jitter_histogram;
+static struct trace_histogram duration_histogram;
+
+/*
+ * Reported by both engines.  Handoff latency is the time from giving SDL a
+ * buffer until SDL is done with it: until the next callback for the pull
+ * engine, until the queue has drained past its last byte for the push engine.
+ * Neither sees the driver's own buffering, which is the same for both.
+ */
+static struct trace_histogram latency_histogram;
+static Uint32 underruns;
+
+#define LATE_CALLBACK 1.5 // periods between two callbacks that count as an underrun
+
+// push engine (-P): the main loop feeds the device with SDL_QueueAudio
+#define PUSH_PENDING 256 // queued buffers being timed
+static SDL_AudioDeviceID push_device;
+static int push_ms;
+
+static void trace_callback(struct AudioSpecUserdata_t *sdata, Uint64 start, int len)
+{
+    struct trace_record r;
+
+    r.timestamp = start;
+    r.issued = sdata->issued;
+    r.event_count = sdata->event_count;
+    r.len = len;
+    r.loaded_len = sdata->loaded_len;
+    r.duration = SDL_GetPerformanceCounter() - start;
+    trace_write(&callback_trace, &r);
+}
+
+// period_us: expected time between two callbacks
+static void drain_trace(int verbose, double period_us)
+{
+    static Uint64 last_timestamp, last_end;
+    const double freq = SDL_GetPerformanceFrequency();
+    struct trace_record r;
+
+    while (trace_read(&callback_trace, &r))
+    {
+        const double duration_us = r.duration * 1e6 / freq;
+
+        if (last_timestamp)
+        {
+            const double interval_us = (r.timestamp - last_timestamp) * 1e6 / freq;
+            trace_histogram_add(&jitter_histogram, fabs(interval_us - period_us));
+            trace_histogram_add(&latency_histogram, (r.timestamp - last_end) * 1e6 / freq);
+            if (interval_us > LATE_CALLBACK * period_us)
+                underruns++;
+        }
+        last_timestamp = r.timestamp;
+        last_end = r.timestamp + r.duration;
+        trace_histogram_add(&duration_histogram, duration_us);
+        if (verbose)
+            printf("%s_callback #%u at %10.3f ms: len %d, loaded_len %u, took %.1f us\n", r.issued,
+                   r.event_count, ms_since_start(r.timestamp), r.len, r.loaded_len, duration_us);
+    }
+}
+
 static int print_userdata(struct AudioSpecUserdata_t *userdata, char *prefix)
 {
     size_t len = 0;
@@ -32,35 +122,222 @@ static int print_userdata(struct AudioSpecUserdata_t *userdata, char *prefix)
         len += printf("%s    buffer:     %12p\n", prefix, userdata->buffer);
         len += printf("%s    buffer_len:   %12d\n", prefix, userdata->buffer_len);
         len += printf("%s    loaded_len:   %12d\n", prefix, userdata->loaded_len);
+        if (userdata->stream)
+            len += printf("%s    stream:     %12p\n", prefix, userdata->stream);
     }
 
     return len;
 }
 
+/*
+ * Streaming with conversion: read a block, convert it, play it, and keep the
+ * converted bytes the device did not take for the next callback.  Only as
+ * much input as the remaining output needs is asked for, so a short read is
+ * a real starvation.
+ */
+static Uint32 read_converted(struct AudioSpecUserdata_t *sdata, Uint8 *dst, Uint32 len)
+{
+    struct converter *cv = sdata->convert;
+    Uint32 copied = 0;
+
+    while (copied < len)
+    {
+        if (sdata->convert_out_pos < sdata->convert_out_len)
+        {
+            Uint32 n = sdata->convert_out_len - sdata->convert_out_pos;
+            if (n > len - copied)
+                n = len - copied;
+            SDL_memcpy(dst + copied, sdata->convert_out + sdata->convert_out_pos, n);
+            sdata->convert_out_pos += n;
+            copied += n;
+            continue;
+        }
+
+        Uint64 frames = (Uint64)((len - copied) / cv->dst_frame + 1) * cv->src_rate / cv->dst_rate + 1;
+        if (frames > CONVERT_BLOCK)
+            frames = CONVERT_BLOCK;
+        const Uint32 got = wav_stream_read(sdata->stream, sdata->convert_in, frames * cv->src_frame);
+        sdata->convert_out_pos = 0;
+        if (got > 0)
+            sdata->convert_out_len = converter_process(cv, sdata->convert_in, got, sdata->convert_out);
+        else if (wav_stream_done(sdata->stream) && !sdata->convert_flushed)
+        {
+            sdata->convert_out_len = converter_flush(cv, sdata->convert_out);
+            sdata->convert_flushed = 1;
+        }
+        else
+        {
+            sdata->convert_out_len = 0;
+            break;
+        }
+    }
+    return copied;
+}
+
+/*
+ * The playback source both engines read from: the loaded buffer, or the
+ * stream when streaming.  Returns the bytes copied, never waits.
+ */
+static Uint32 read_source(struct AudioSpecUserdata_t *sdata, Uint8 *dst, Uint32 len)
+{
+    Uint32 got;
+
+    if (sdata->stream)
+    {
+        got = sdata->convert ? read_converted(sdata, dst, len) : wav_stream_read(sdata->stream, dst, len);
+        sdata->loaded_len += got;
+        return got;
+    }
+    if (!sdata->buffer)
+        return 0;
+    got = SDL_min(len, sdata->buffer_len - sdata->loaded_len);
+    SDL_memcpy(dst, sdata->buffer + sdata->loaded_len, got); // simply copy from one buffer into the other
+    sdata->loaded_len += got;
+    return got;
+}
+
+static int source_done(struct AudioSpecUserdata_t *sdata)
+{
+    if (sdata->stream)
+        return wav_stream_done(sdata->stream) &&
+               (!sdata->convert || (sdata->convert_flushed && sdata->convert_out_pos == sdata->convert_out_len));
+    return sdata->loaded_len >= sdata->buffer_len;
+}
+
 static struct AudioSpecUserdata_t OpenAudio_callback_userdata;
 static void OpenAudio_callback(void *userdata, Uint8 *stream, int len)
 {
     struct AudioSpecUserdata_t *sdata = (struct AudioSpecUserdata_t *)userdata;
-    Uint32 new_len;
+    const Uint64 start = SDL_GetPerformanceCounter();
 
-    printf("OpenAudio_callback (void *userdata, Uint8 *stream, int len) - triggered\n");
+    if (sdata->event_count == 0)
+        first_callback_counter = start;
     sdata->event_count++;
-    print_userdata(sdata, "");
-    printf("  stream:         %12p\n", stream);
-    printf("  len:            %12d\n", len);
 
-    if (len > 0 && sdata && sdata->buffer)
+    if (len > 0)
     {
-        if ((new_len = sdata->loaded_len + len) > sdata->buffer_len)
+        // never wait for the I/O thread: whatever is not ready yet is silence
+        Uint32 got = read_source(sdata, stream, len);
+        SDL_memset(stream + got, sdata->silence, len - got);
+    }
+    if (source_done(sdata))
+        Quit = 1;
+    trace_callback(sdata, start, len);
+}
+
+/*
+ * Push engine: keep depth bytes queued, topping up from the same source the
+ * callback reads, in buffers of at most chunk bytes.  Seeing the queue empty
+ * while there is still data counts as an underrun; the device still holds
+ * its current buffer at that point, so near misses count too.
+ */
+static void push_play(struct AudioSpecUserdata_t *sdata, Uint32 chunk_len, Uint32 depth)
+{
+    struct
+    {
+        Uint64 queued_at;
+        Uint64 end; // queued_total after this buffer
+    } pending[PUSH_PENDING];
+    unsigned head = 0, tail = 0;
+    Uint64 queued_total = 0;
+    const double freq = SDL_GetPerformanceFrequency();
+    int exhausted = 0, was_empty = 0, started = 0;
+    Uint8 *chunk = SDL_malloc(chunk_len);
+
+    if (chunk == NULL)
+    {
+        printf("[SDL]  Couldn't allocate the push buffer\n");
+        return;
+    }
+
+    for (;;)
+    {
+        Uint32 queued = SDL_GetQueuedAudioSize(push_device);
+        const Uint64 now = SDL_GetPerformanceCounter();
+
+        while (tail != head && pending[tail % PUSH_PENDING].end <= queued_total - queued)
         {
-            len = sdata->buffer_len - sdata->loaded_len;
-            new_len = sdata->buffer_len;
+            trace_histogram_add(&latency_histogram, (now - pending[tail % PUSH_PENDING].queued_at) * 1e6 / freq);
+            tail++;
         }
-        SDL_memcpy(stream, sdata->buffer + sdata->loaded_len, len); // simply copy from one buffer into the other
-        sdata->loaded_len = new_len;
+        if (queued == 0 && queued_total > 0 && !exhausted && !was_empty)
+            underruns++;
+        was_empty = (queued == 0);
+        if (exhausted && queued == 0)
+            break;
+
+        while (!exhausted && queued < depth && head - tail < PUSH_PENDING)
+        {
+            const Uint32 got = read_source(sdata, chunk, SDL_min(chunk_len, depth - queued));
+            if (got == 0)
+            {
+                exhausted = source_done(sdata);
+                break;
+            }
+            if (SDL_QueueAudio(push_device, chunk, got) < 0)
+            {
+                printf("[SDL]  SDL_QueueAudio failed: %s\n", SDL_GetError());
+                exhausted = 1;
+                break;
+            }
+            if (sdata->event_count++ == 0)
+                first_callback_counter = SDL_GetPerformanceCounter();
+            queued_total += got;
+            queued += got;
+            pending[head % PUSH_PENDING].queued_at = SDL_GetPerformanceCounter();
+            pending[head % PUSH_PENDING].end = queued_total;
+            head++;
+        }
+        if (!started)
+        {
+            // the queue is full now, so the first buffer is not an underrun
+            SDL_PauseAudioDevice(push_device, 0);
+            started = 1;
+        }
+        SDL_Delay(1);
     }
-    if (sdata->loaded_len >= sdata->buffer_len)
-        Quit = 1;
+    SDL_free(chunk);
+}
+
+/*
+ * Opens the device for either engine.  sdl_converts: open exactly the file's
+ * format and let SDL convert; otherwise obtained may differ.
+ */
+static int open_audio(SDL_AudioSpec *desired, SDL_AudioSpec *obtained, int sdl_converts)
+{
+    if (push_ms)
+    {
+        SDL_AudioSpec want = *desired;
+        want.callback = NULL;
+        want.userdata = NULL;
+        printf("[SDL]SDL_OpenAudioDevice(NULL, 0, loadWAV_spec, openAudio_obtained_spec, %s)\n",
+               sdl_converts ? "0" : "SDL_AUDIO_ALLOW_ANY_CHANGE");
+        push_device = SDL_OpenAudioDevice(NULL, 0, &want, obtained, sdl_converts ? 0 : SDL_AUDIO_ALLOW_ANY_CHANGE);
+        return push_device ? 0 : -1;
+    }
+    if (sdl_converts)
+    {
+        printf("[SDL]SDL_OpenAudio(loadWAV_spec, NULL)\n");
+        if (SDL_OpenAudio(desired, NULL) != 0)
+            return -1;
+        *obtained = *desired;
+        return 0;
+    }
+    printf("[SDL]SDL_OpenAudio(loadWAV_spec, openAudio_obtained_spec)\n");
+    return SDL_OpenAudio(desired, obtained);
+}
+
+static void close_audio(void)
+{
+    if (push_device)
+    {
+        printf("[SDL] SDL_CloseAudioDevice(%u)\n", push_device);
+        SDL_CloseAudioDevice(push_device);
+        push_device = 0;
+        return;
+    }
+    printf("[SDL] SDL_CloseAudio()\n");
+    SDL_CloseAudio();
 }
 
 // it might be the same but the address should be different.
@@ -68,13 +345,11 @@ static struct AudioSpecUserdata_t LoadWAV_callback_userdata;
 static void LoadWAV_callback(void *userdata, Uint8 *stream, int len)
 {
     struct AudioSpecUserdata_t *sdata = (struct AudioSpecUserdata_t *)userdata;
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const int requested = len;
     Uint32 new_len;
 
-    printf("LoadWAV_callback (void *userdata, Uint8 *stream, int len) - triggered\n");
     sdata->event_count++;
-    print_userdata((struct AudioSpecUserdata_t *)userdata, "");
-    printf("  stream:         %p\n", stream);
-    printf("  len:            %12d\n", len);
 
     if (len > 0 && sdata && sdata->buffer)
     {
@@ -88,6 +363,167 @@ static void LoadWAV_callback(void *userdata, Uint8 *stream, int len)
     }
     if (sdata->loaded_len >= sdata->buffer_len)
         Quit = 1;
+    trace_callback(sdata, start, requested);
+}
+
+#define BANK_TRIGGERS 64 // sounds triggered by -S
+#define BANK_SAMPLES 512 // frames per mixer callback
+
+static void bank_callback(void *userdata, Uint8 *stream, int len)
+{
+    struct mixer *m = userdata;
+    const Uint64 start = SDL_GetPerformanceCounter();
+    struct trace_record r;
+
+    if (m->callbacks == 0)
+        first_callback_counter = start;
+    mixer_mix(m, (Sint16 *)stream, len / sizeof(Sint16));
+    r.timestamp = start;
+    r.issued = "mixer";
+    r.event_count = m->callbacks;
+    r.len = len;
+    r.loaded_len = atomic_load_explicit(&m->active, memory_order_relaxed);
+    r.duration = SDL_GetPerformanceCounter() - start;
+    trace_write(&callback_trace, &r);
+}
+
+static void drain_triggers(struct mixer *m, struct trace_histogram *h, int verbose)
+{
+    const double freq = SDL_GetPerformanceFrequency();
+    struct trace_record r;
+
+    while (trace_read(&m->starts, &r))
+    {
+        trace_histogram_add(h, r.duration * 1e6 / freq);
+        if (verbose)
+            printf("trigger \"%s\" at %10.3f ms: voice %d in callback #%u after %.1f us\n",
+                   bank_name(m->bank, r.event_count), ms_since_start(r.timestamp), r.len, r.loaded_len,
+                   r.duration * 1e6 / freq);
+    }
+}
+
+/*
+ * -S: load every file into one bank, then trigger the sounds in turn every
+ * interval_ms at varying gains from the main thread while the mixer plays
+ * them from the callback.
+ */
+static int play_bank(char **files, int count, int interval_ms, int verbose)
+{
+    static struct mixer mixer;
+    struct trace_histogram trigger_histogram = {};
+    SDL_AudioSpec want = {}, have;
+    struct bank bank;
+
+    want.freq = 48000;
+    want.format = AUDIO_S16LSB;
+    want.channels = 2;
+    want.samples = BANK_SAMPLES;
+    want.callback = bank_callback;
+    want.userdata = &mixer;
+    SDL_AudioDeviceID dev = SDL_OpenAudioDevice(NULL, 0, &want, &have,
+                                                SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE);
+    if (dev == 0)
+    {
+        printf("[SDL]  Couldn't open audio: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    const Uint64 load_start = SDL_GetPerformanceCounter();
+    if (bank_load(&bank, files, count, have.freq, have.channels) < 0)
+    {
+        printf("[bank] %s\n", SDL_GetError());
+        SDL_CloseAudioDevice(dev);
+        return 1;
+    }
+    const double load_ms = (SDL_GetPerformanceCounter() - load_start) * 1000.0 / SDL_GetPerformanceFrequency();
+    printf("[bank] %d sounds, %u KB arena, %zu bytes of index and names, loaded in %.2f ms\n", bank.count,
+           (unsigned)(bank.arena_len * sizeof(Sint16) / 1024), bank.count * sizeof(struct bank_entry) + bank.names_len,
+           load_ms);
+
+    mixer_init(&mixer, &bank);
+    SDL_PauseAudioDevice(dev, 0);
+
+    const double period_us = have.samples * 1e6 / have.freq;
+    for (int i = 0; i < BANK_TRIGGERS; i++)
+    {
+        if (mixer_trigger(&mixer, i % bank.count, MIXER_UNITY / (1 + i % 4)) < 0)
+            printf("[mixer] %s\n", SDL_GetError());
+        SDL_Delay(interval_ms);
+        drain_trace(verbose, period_us);
+        drain_triggers(&mixer, &trigger_histogram, verbose);
+    }
+    // let the last voices ring out
+    while (atomic_load(&mixer.tail) != atomic_load(&mixer.head) || atomic_load(&mixer.active) > 0)
+    {
+        SDL_Delay(10);
+        drain_trace(verbose, period_us);
+        drain_triggers(&mixer, &trigger_histogram, verbose);
+    }
+    SDL_CloseAudioDevice(dev);
+    drain_trace(verbose, period_us);
+    drain_triggers(&mixer, &trigger_histogram, verbose);
+
+    printf("mixer:                  %s kernel, %d voices, %d-sample buffers at %d Hz\n", mixer.k->name,
+           MIXER_VOICES, have.samples, have.freq);
+    printf("triggers:               %10d (%u dropped, %u voices stolen)\n", BANK_TRIGGERS,
+           atomic_load(&mixer.dropped), atomic_load(&mixer.stolen));
+    printf("peak voices:            %10u\n", mixer.peak_voices);
+    printf("underruns:              %10u\n", underruns);
+    // the buffer a trigger is mixed into plays after the wait
+    trace_histogram_print(&trigger_histogram, "trigger to mix (output follows one buffer later)");
+    trace_histogram_print(&duration_histogram, "mixer callback duration");
+    trace_histogram_print(&jitter_histogram, "callback interval jitter (|interval - period|)");
+    printf("trace records lost:     %10u\n", atomic_load(&callback_trace.lost) + atomic_load(&mixer.starts.lost));
+
+    bank_free(&bank);
+    return 0;
+}
+
+/*
+ * -V: decode and check every WAV below dir without opening a device.  Files
+ * go to threads workers; the rates are for all of them together.
+ */
+static int validate_dir(const char *dir, int threads, int verbose)
+{
+    const double freq = SDL_GetPerformanceFrequency();
+    struct batch b;
+    Uint64 bytes = 0;
+    double seconds = 0;
+    int failed = 0;
+
+    const Uint64 scan_start = SDL_GetPerformanceCounter();
+    if (batch_scan(&b, dir) < 0)
+    {
+        printf("[batch] %s\n", SDL_GetError());
+        return 1;
+    }
+    const Uint64 start = SDL_GetPerformanceCounter();
+    threads = batch_run(&b, threads);
+    const double wall = (SDL_GetPerformanceCounter() - start) / freq;
+
+    for (int i = 0; i < b.count; i++)
+    {
+        const struct batch_file *f = &b.files[i];
+        bytes += f->size;
+        seconds += f->seconds;
+        if (!f->ok)
+        {
+            failed++;
+            printf("FAIL %s: %s\n", f->path, f->error);
+        }
+        else if (verbose)
+            printf("ok   %s: %d Hz, 0x%04x, %d ch, %.2f s\n", f->path, f->spec.freq, f->spec.format,
+                   f->spec.channels, f->seconds);
+    }
+
+    printf("files:                  %10d (%d failed) in \"%s\"\n", b.count, failed, dir);
+    printf("scan time:              %10.2f ms\n", (start - scan_start) * 1000.0 / freq);
+    printf("check time:             %10.2f ms on %d threads\n", wall * 1000.0, threads);
+    printf("files/s:                %10.1f\n", wall > 0 ? b.count / wall : 0.0);
+    printf("MB/s:                   %10.1f (%.1f MB on disk)\n", wall > 0 ? bytes / wall / 1e6 : 0.0, bytes / 1e6);
+    printf("audio checked:          %10.1f s (%.0fx real time)\n", seconds, wall > 0 ? seconds / wall : 0.0);
+    batch_free(&b);
+    return failed > 0;
 }
 
 static int print_spec(SDL_AudioSpec *spec, char *label)
@@ -119,47 +555,179 @@ int main(int argc, char *argv[])
     SDL_AudioSpec openAudio_obtained_spec;
     Uint32 audio_len;
     Uint8 *audio_buf;
+    Uint8 *converted_buf = NULL;
+    struct wav_map wav = {};
+    struct wav_stream wstream = {};
+    struct converter converter = {};
+    enum convert_quality quality = CONVERT_MEDIUM;
+    int use_sdl_convert = 0;
+    double convert_ms = 0;
+    int use_mmap = 0;
+    int use_stream = 0;
+    int read_delay_ms = 0;
+    int bank_ms = 0;
+    char *validate = NULL;
+    int threads = SDL_GetCPUCount();
+    int bad_args = 0;
+    int verbose = 1;
+    int opt;
 
-    if (argc < 2)
+    start_counter = SDL_GetPerformanceCounter();
+
+    while ((opt = getopt(argc, argv, "CP:Q:S:V:d:j:mqs")) != -1)
     {
-        file = DEFAULT_AUDIO_PATH;
-        printf("Using default wav file: \"%s\"\n", file);
+        switch (opt)
+        {
+        case 'C':
+            return convert_compare() < 0;
+        case 'P':
+            push_ms = atoi(optarg);
+            bad_args |= push_ms <= 0;
+            break;
+        case 'S':
+            bank_ms = atoi(optarg);
+            bad_args |= bank_ms <= 0;
+            break;
+        case 'V':
+            validate = optarg;
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            bad_args |= threads <= 0;
+            break;
+        case 'Q':
+            use_sdl_convert = !strcmp(optarg, "sdl");
+            for (quality = 0; quality < CONVERT_QUALITIES; quality++)
+                if (!strcmp(optarg, convert_quality_names[quality]))
+                    break;
+            if (quality == CONVERT_QUALITIES)
+            {
+                quality = CONVERT_MEDIUM;
+                bad_args |= !use_sdl_convert;
+            }
+            break;
+        case 'd':
+            read_delay_ms = atoi(optarg);
+            bad_args |= read_delay_ms < 0;
+            break;
+        case 'm':
+            use_mmap = 1;
+            break;
+        case 'q':
+            verbose = 0;
+            break;
+        case 's':
+            use_stream = 1;
+            break;
+        default:
+            bad_args = 1;
+            break;
+        }
     }
-    else if (*argv[1] != '-')
+    if (bad_args || (use_mmap && use_stream) || (bank_ms && (use_mmap || use_stream || push_ms)))
     {
-        file = argv[1];
+        printf("Usage is %s [-q] [-P ms] [-Q fast|medium|best|sdl] [-m | -s [-d ms]] [<filename>]\n", argv[0]);
+        printf("       %s [-q] -S ms [<filename> ...]\n", argv[0]);
+        printf("       %s [-q] -V dir [-j threads]\n", argv[0]);
+        printf("       %s -C\n", argv[0]);
+        printf("  -q  only print the callback histograms, not every callback\n");
+        printf("  -m  map the file and play straight from the mapping instead of SDL_LoadWAV\n");
+        printf("  -s  stream the file through %d chunks of %d KB read ahead by an I/O thread\n",
+               STREAM_CHUNKS, STREAM_CHUNK_BYTES / 1024);
+        printf("  -d  delay every streaming read by ms, to simulate slow storage\n");
+        printf("  -P  push with SDL_QueueAudio, keeping ms of audio queued, instead of the callback\n");
+        printf("      (SDL_AUDIODRIVER=disk or dummy gives repeatable numbers for either engine)\n");
+        printf("  -Q  how to convert when the device wants another format: resampler quality\n");
+        printf("      (default medium) or sdl for SDL_AudioCVT/SDL's own stream conversion\n");
+        printf("  -S  load every file into one sound bank and trigger them in turn every ms through\n");
+        printf("      the %d-voice mixer\n", MIXER_VOICES);
+        printf("  -V  decode and check every .wav below dir on -j threads (default %d), no playback\n",
+               SDL_GetCPUCount());
+        printf("  -C  compare the converter with SDL_AudioCVT and SDL_AudioStream and exit\n");
+        return 0;
+    }
+
+    if (validate)
+        return validate_dir(validate, threads, verbose);
+
+    if (optind >= argc)
+    {
+        file = DEFAULT_AUDIO_PATH;
+        printf("Using default wav file: \"%s\"\n", file);
     }
     else
     {
-        printf("Usage is %s <filename>\n", argv[0]);
-        return 0;
+        file = argv[optind];
     }
 
+    trace_init(&callback_trace);
+
     // Initialize SDL.
     if (SDL_Init(SDL_INIT_AUDIO) < 0)
     {
         printf("SDL_Init(SDL_INIT_AUDIO) < 0\n");
         return 1;
     }
+    if (bank_ms)
+    {
+        const int ret = optind < argc ? play_bank(argv + optind, argc - optind, bank_ms, verbose)
+                                      : play_bank(&file, 1, bank_ms, verbose);
+        SDL_Quit();
+        return ret;
+    }
 
     /* open wav file, put specification in have, audio location in audiobuf and length in length */
     loadWAV_spec.callback = LoadWAV_callback;
     loadWAV_spec.userdata = &LoadWAV_callback_userdata;
     LoadWAV_callback_userdata.file = file;
     LoadWAV_callback_userdata.loaded_len = 0;
-    if (!SDL_LoadWAV(file, &loadWAV_spec, &audio_buf, &audio_len))
+    if (use_mmap && wav_map(file, &wav) < 0)
+    {
+        // ADPCM and other encoded data still needs SDL_LoadWAV's decoder
+        printf("[wav] Cannot map \"%s\" (%s), falling back to SDL_LoadWAV\n", file, SDL_GetError());
+        use_mmap = 0;
+    }
+    if (use_stream && wav_stream_open(file, &wstream) < 0)
+    {
+        printf("[wav] Cannot stream \"%s\" (%s), falling back to SDL_LoadWAV\n", file, SDL_GetError());
+        use_stream = 0;
+    }
+    if (use_stream)
+    {
+        loadWAV_spec.freq = wstream.spec.freq;
+        loadWAV_spec.format = wstream.spec.format;
+        loadWAV_spec.channels = wstream.spec.channels;
+        loadWAV_spec.samples = 4096;
+        wstream.read_delay_ms = read_delay_ms;
+        audio_buf = NULL;
+        audio_len = wstream.data_len;
+        printf("[wav] wav_stream_open(\"%s\", ...) streams %d bytes from offset %ld\n", file,
+               audio_len, (long)wstream.data_offset);
+    }
+    else if (use_mmap)
+    {
+        loadWAV_spec.freq = wav.spec.freq;
+        loadWAV_spec.format = wav.spec.format;
+        loadWAV_spec.channels = wav.spec.channels;
+        loadWAV_spec.samples = 4096; // what SDL_LoadWAV asks for
+        audio_buf = wav.data;
+        audio_len = wav.data_len;
+        printf("[wav] wav_map(\"%s\", ...) mapped %zu bytes\n", file, wav.map_size);
+    }
+    else if (!SDL_LoadWAV(file, &loadWAV_spec, &audio_buf, &audio_len))
     {
         printf("[SDL] Failed: SDL_LoadWAV(\"%s\", ...): %s\n", file, SDL_GetError());
         SDL_Quit();
         return 1;
     }
+    const double load_ms = ms_since_start(SDL_GetPerformanceCounter());
 
-    LoadWAV_callback_userdata.issued = "SDL_LoadWAV";
+    LoadWAV_callback_userdata.issued = use_stream ? "wav_stream_open" : use_mmap ? "wav_map" : "SDL_LoadWAV";
     LoadWAV_callback_userdata.file = file;
     LoadWAV_callback_userdata.buffer = audio_buf;
     LoadWAV_callback_userdata.buffer_len = audio_len;
     LoadWAV_callback_userdata.event_count = 0;
-    printf("[SDL] SDL_LoadWAV(\"%s\", ...) obtained:\n", file);
+    printf("[SDL] %s(\"%s\", ...) obtained:\n", LoadWAV_callback_userdata.issued, file);
     print_spec(&loadWAV_spec, "loadWAV_spec");
     printf("  audio_buf:  %p The audio buffer\n", audio_buf);
     printf("  audio_len:    %12d The length of the audio buffer in bytes\n", audio_len);
@@ -174,28 +742,140 @@ int main(int argc, char *argv[])
     OpenAudio_callback_userdata.buffer = audio_buf;
     OpenAudio_callback_userdata.buffer_len = audio_len;
     OpenAudio_callback_userdata.event_count = 0;
-    printf("[SDL]SDL_OpenAudio(loadWAV_spec, openAudio_obtained_spec)\n");
-    if (SDL_OpenAudio(&loadWAV_spec, &openAudio_obtained_spec) != 0)
+    OpenAudio_callback_userdata.stream = use_stream ? &wstream : NULL;
+    // streamed chunks arrive as they are read, -Q sdl lets SDL convert them to the device format
+    if (open_audio(&loadWAV_spec, &openAudio_obtained_spec, use_stream && use_sdl_convert) != 0)
     {
         printf("[SDL]  Couldn't open audio: %s\n", SDL_GetError());
         exit(-1);
     }
+    OpenAudio_callback_userdata.silence = openAudio_obtained_spec.silence;
     print_spec(&loadWAV_spec, "loadWAV_spec");
     print_spec(&openAudio_obtained_spec, "openAudio_obtained_spec");
 
+    /*
+  * The device may have picked another format; the callback copies bytes as
+  * they are, so convert a copy in that case, or every block as it is streamed.
+  * Otherwise a mapped file is played straight from the mapping.
+  */
+    int needs_convert = openAudio_obtained_spec.freq != loadWAV_spec.freq ||
+                        openAudio_obtained_spec.format != loadWAV_spec.format ||
+                        openAudio_obtained_spec.channels != loadWAV_spec.channels;
+    if (needs_convert && !use_sdl_convert &&
+        converter_init(&converter, loadWAV_spec.format, loadWAV_spec.channels, loadWAV_spec.freq,
+                       openAudio_obtained_spec.format, openAudio_obtained_spec.channels,
+                       openAudio_obtained_spec.freq, quality) < 0)
+    {
+        printf("[convert] %s, falling back to SDL\n", SDL_GetError());
+        use_sdl_convert = 1;
+        if (use_stream)
+        {
+            close_audio();
+            if (open_audio(&loadWAV_spec, &openAudio_obtained_spec, 1) != 0)
+            {
+                printf("[SDL]  Couldn't open audio: %s\n", SDL_GetError());
+                exit(-1);
+            }
+            OpenAudio_callback_userdata.silence = openAudio_obtained_spec.silence;
+            needs_convert = 0;
+        }
+    }
+    if (needs_convert && !use_sdl_convert)
+        printf("[convert] %s kernels, %s quality (%d taps)\n", converter.k->name,
+               convert_quality_names[quality], converter.taps);
+
+    if (needs_convert && use_stream)
+    {
+        // preallocated: the callback converts one block at a time
+        const size_t out_len = converter_max_output(&converter, CONVERT_BLOCK * converter.src_frame);
+        if ((OpenAudio_callback_userdata.convert_in = SDL_malloc(CONVERT_BLOCK * converter.src_frame)) == NULL ||
+            (OpenAudio_callback_userdata.convert_out = SDL_malloc(out_len)) == NULL)
+        {
+            printf("[convert]  Couldn't allocate the block buffers\n");
+            exit(-1);
+        }
+        OpenAudio_callback_userdata.convert = &converter;
+    }
+    else if (needs_convert && !use_sdl_convert)
+    {
+        const Uint64 start = SDL_GetPerformanceCounter();
+        if ((converted_buf = SDL_malloc(converter_max_output(&converter, audio_len))) == NULL)
+        {
+            printf("[convert]  Couldn't allocate the converted copy\n");
+            exit(-1);
+        }
+        size_t len = converter_process(&converter, audio_buf, audio_len, converted_buf);
+        len += converter_flush(&converter, converted_buf + len);
+        convert_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        OpenAudio_callback_userdata.buffer = converted_buf;
+        OpenAudio_callback_userdata.buffer_len = len;
+        printf("[convert] Converted %d bytes to %zu bytes in the device format\n", audio_len, len);
+    }
+    else if (needs_convert)
+    {
+        const Uint64 start = SDL_GetPerformanceCounter();
+        SDL_AudioCVT cvt;
+        if (SDL_BuildAudioCVT(&cvt, loadWAV_spec.format, loadWAV_spec.channels, loadWAV_spec.freq,
+                              openAudio_obtained_spec.format, openAudio_obtained_spec.channels,
+                              openAudio_obtained_spec.freq) < 0 ||
+            (cvt.buf = SDL_malloc((size_t)audio_len * cvt.len_mult)) == NULL)
+        {
+            printf("[SDL]  Couldn't convert to the device format: %s\n", SDL_GetError());
+            exit(-1);
+        }
+        cvt.len = audio_len;
+        SDL_memcpy(cvt.buf, audio_buf, audio_len);
+        SDL_ConvertAudio(&cvt);
+        convert_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+        converted_buf = cvt.buf;
+        OpenAudio_callback_userdata.buffer = converted_buf;
+        OpenAudio_callback_userdata.buffer_len = cvt.len_cvt;
+        printf("[SDL] Converted %d bytes to %d bytes in the device format\n", audio_len, cvt.len_cvt);
+    }
+
     /*
   * Play audio
   */
 
-    printf("[SDL] SDL_PauseAudio(0)\n");
-    SDL_PauseAudio(0);
+    if (use_stream)
+    {
+        printf("[wav] wav_stream_start(%p)\n", &wstream);
+        if (wav_stream_start(&wstream) < 0)
+        {
+            printf("[wav]  Couldn't start the I/O thread: %s\n", SDL_GetError());
+            exit(-1);
+        }
+    }
 
-    // wait until we're done playing
-    //	while ( ! Quit && OpenAudio_callback_userdata.loaded_len < OpenAudio_callback_userdata.buffer_len) {
-    while (!Quit)
+    struct rusage play_ru;
+    getrusage(RUSAGE_SELF, &play_ru);
+    const Uint64 play_start = SDL_GetPerformanceCounter();
+
+    const double period_us = openAudio_obtained_spec.samples * 1e6 / openAudio_obtained_spec.freq;
+    if (push_device)
     {
-        SDL_Delay(100);
+        const int frame = openAudio_obtained_spec.channels * (SDL_AUDIO_BITSIZE(openAudio_obtained_spec.format) / 8);
+        const Uint32 depth = (Uint32)((Sint64)push_ms * openAudio_obtained_spec.freq / 1000) * frame;
+
+        OpenAudio_callback_userdata.issued = "QueueAudio";
+        printf("[SDL] SDL_QueueAudio(%u, ...), queue depth %d ms (%u bytes)\n", push_device, push_ms, depth);
+        push_play(&OpenAudio_callback_userdata, openAudio_obtained_spec.size, SDL_max(depth, (Uint32)frame));
     }
+    else
+    {
+        printf("[SDL] SDL_PauseAudio(0)\n");
+        SDL_PauseAudio(0);
+
+        // wait until we're done playing
+        //	while ( ! Quit && OpenAudio_callback_userdata.loaded_len < OpenAudio_callback_userdata.buffer_len) {
+        while (!Quit)
+        {
+            drain_trace(verbose, period_us);
+            SDL_Delay(100);
+        }
+        drain_trace(verbose, period_us);
+    }
+    const double play_s = (SDL_GetPerformanceCounter() - play_start) / (double)SDL_GetPerformanceFrequency();
 
     printf("wav file (\"%s\") all done playing\n", file);
     print_spec(&loadWAV_spec, "loadWAV_spec");
@@ -206,11 +886,61 @@ int main(int argc, char *argv[])
     printf("  audio_len:    %12d The length of the audio buffer in bytes\n", OpenAudio_callback_userdata.buffer_len);
 
     // shut everything down
-    printf("[SDL] SDL_CloseAudio()\n");
-    SDL_CloseAudio();
+    close_audio();
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    const double cpu_s = (ru.ru_utime.tv_sec - play_ru.ru_utime.tv_sec) + (ru.ru_stime.tv_sec - play_ru.ru_stime.tv_sec) +
+                         ((ru.ru_utime.tv_usec - play_ru.ru_utime.tv_usec) + (ru.ru_stime.tv_usec - play_ru.ru_stime.tv_usec)) / 1e6;
+    printf("loader:                 %s%s\n", LoadWAV_callback_userdata.issued,
+           converted_buf ? " (converted copy)" : use_mmap ? " (zero-copy)" : "");
+    printf("load time:              %10.2f ms\n", load_ms);
+    if (converted_buf)
+        printf("conversion time:        %10.2f ms (%s)\n", convert_ms,
+               use_sdl_convert ? "SDL_AudioCVT" : convert_quality_names[quality]);
+    printf("time to first callback: %10.2f ms\n", ms_since_start(first_callback_counter));
+    printf("peak RSS:               %10ld KB\n", ru.ru_maxrss);
+    if (push_ms)
+        printf("engine:                 push, SDL_QueueAudio with %d ms queued\n", push_ms);
+    else
+        printf("engine:                 pull, callback every %d samples\n", openAudio_obtained_spec.samples);
+    printf("CPU during playback:    %10.2f %% (%.3f s in %.3f s)\n", play_s > 0 ? cpu_s * 100.0 / play_s : 0.0,
+           cpu_s, play_s);
+    // pull: late callbacks and streamed bytes not ready in time; push: the queue ran dry
+    printf("underruns:              %10u\n", underruns + (push_ms ? 0 : wstream.starvations));
+    trace_histogram_print(&latency_histogram, "handoff latency (given to SDL until consumed)");
+    if (!push_ms)
+    {
+        trace_histogram_print(&jitter_histogram, "callback interval jitter (|interval - period|)");
+        trace_histogram_print(&duration_histogram, "callback duration");
+        printf("trace records lost:     %10u\n", atomic_load(&callback_trace.lost));
+    }
 
-    printf("[SDL] SDL_FreeWAV(%p)\n", audio_buf);
-    SDL_FreeWAV(audio_buf);
+    SDL_free(converted_buf);
+    SDL_free(OpenAudio_callback_userdata.convert_in);
+    SDL_free(OpenAudio_callback_userdata.convert_out);
+    converter_free(&converter);
+    if (use_stream)
+    {
+        printf("read-ahead pool:        %10d KB (%d chunks)\n",
+               STREAM_CHUNKS * STREAM_CHUNK_BYTES / 1024, STREAM_CHUNKS);
+        printf("starvations:            %10u (%u bytes of silence)\n",
+               wstream.starvations, wstream.starved_bytes);
+        printf("read stalls:            %10u (> %d ms, slowest %.1f ms)\n",
+               wstream.read_stalls, STREAM_STALL_MS, wstream.slowest_read_ms);
+        printf("[wav] wav_stream_close(%p)\n", &wstream);
+        wav_stream_close(&wstream);
+    }
+    else if (use_mmap)
+    {
+        printf("[wav] wav_unmap(%p)\n", wav.map);
+        wav_unmap(&wav);
+    }
+    else
+    {
+        printf("[SDL] SDL_FreeWAV(%p)\n", audio_buf);
+        SDL_FreeWAV(audio_buf);
+    }
     printf("[SDL] SDL_Quit()\n");
     SDL_Quit();
 
@@ -0,0 +1,168 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stream.h"
+#include "wav.h"
+
+int wav_stream_open(const char *file, struct wav_stream *s)
+{
+    struct wav_map wav;
+
+    SDL_zerop(s);
+    s->fd = -1;
+
+    // the mapping is only used to parse the header, the samples are never touched
+    if (wav_map(file, &wav) < 0)
+        return -1;
+    s->spec = wav.spec;
+    s->data_offset = wav.data - (Uint8 *)wav.map;
+    s->data_len = wav.data_len;
+    s->frame_size = SDL_AUDIO_BITSIZE(s->spec.format) / 8 * s->spec.channels;
+    wav_unmap(&wav);
+
+    if ((s->fd = open(file, O_RDONLY)) < 0)
+        return SDL_SetError("open(\"%s\"): %s", file, strerror(errno));
+    posix_fadvise(s->fd, s->data_offset, s->data_len, POSIX_FADV_SEQUENTIAL);
+
+    if ((s->pool = SDL_malloc(STREAM_CHUNKS * STREAM_CHUNK_BYTES)) == NULL ||
+        (s->space = SDL_CreateSemaphore(0)) == NULL)
+    {
+        wav_stream_close(s);
+        return SDL_OutOfMemory();
+    }
+    for (int i = 0; i < STREAM_CHUNKS; i++)
+        s->chunks[i].data = s->pool + i * STREAM_CHUNK_BYTES;
+    atomic_init(&s->head, 0);
+    atomic_init(&s->tail, 0);
+    atomic_init(&s->eof, 0);
+    atomic_init(&s->quit, 0);
+    return 0;
+}
+
+// read all of len bytes at pos unless the file ends or fails first
+static Uint32 read_fully(int fd, Uint8 *dst, Uint32 len, off_t pos)
+{
+    Uint32 got = 0;
+
+    while (got < len)
+    {
+        ssize_t n = pread(fd, dst + got, len - got, pos + got);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        got += n;
+    }
+    return got;
+}
+
+static int io_thread(void *data)
+{
+    struct wav_stream *s = data;
+    Uint32 pos = 0;
+    const double freq = SDL_GetPerformanceFrequency();
+
+    while (pos < s->data_len && !atomic_load(&s->quit))
+    {
+        const unsigned head = atomic_load_explicit(&s->head, memory_order_relaxed);
+        if (head - atomic_load_explicit(&s->tail, memory_order_acquire) == STREAM_CHUNKS)
+        {
+            // pool full: wait for the callback to hand a chunk back
+            SDL_SemWaitTimeout(s->space, 100);
+            continue;
+        }
+
+        struct stream_chunk *chunk = &s->chunks[head % STREAM_CHUNKS];
+        Uint32 len = s->data_len - pos;
+        if (len > STREAM_CHUNK_BYTES)
+            len = STREAM_CHUNK_BYTES - STREAM_CHUNK_BYTES % s->frame_size;
+
+        const Uint64 start = SDL_GetPerformanceCounter();
+        if (s->read_delay_ms)
+            SDL_Delay(s->read_delay_ms);
+        chunk->len = read_fully(s->fd, chunk->data, len, s->data_offset + pos);
+        chunk->len -= chunk->len % s->frame_size; // a file cut short mid-frame
+        const double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / freq;
+        if (ms > STREAM_STALL_MS)
+            s->read_stalls++;
+        if (ms > s->slowest_read_ms)
+            s->slowest_read_ms = ms;
+
+        if (chunk->len == 0)
+            break; // truncated or unreadable: play what we have
+        pos += chunk->len;
+        atomic_store_explicit(&s->head, head + 1, memory_order_release);
+    }
+
+    atomic_store(&s->eof, 1);
+    return 0;
+}
+
+int wav_stream_start(struct wav_stream *s)
+{
+    if ((s->thread = SDL_CreateThread(io_thread, "wav_stream", s)) == NULL)
+        return -1;
+    while (atomic_load(&s->head) == 0 && !atomic_load(&s->eof))
+        SDL_Delay(1);
+    return 0;
+}
+
+Uint32 wav_stream_read(struct wav_stream *s, Uint8 *dst, Uint32 len)
+{
+    Uint32 copied = 0;
+
+    // every chunk holds whole frames, so copying whole frames never splits one
+    len -= len % s->frame_size;
+    while (copied < len)
+    {
+        const unsigned tail = atomic_load_explicit(&s->tail, memory_order_relaxed);
+        if (atomic_load_explicit(&s->head, memory_order_acquire) == tail)
+            break;
+
+        struct stream_chunk *chunk = &s->chunks[tail % STREAM_CHUNKS];
+        Uint32 n = chunk->len - s->offset;
+        if (n > len - copied)
+            n = len - copied;
+        SDL_memcpy(dst + copied, chunk->data + s->offset, n);
+        copied += n;
+        s->offset += n;
+        if (s->offset == chunk->len)
+        {
+            s->offset = 0;
+            atomic_store_explicit(&s->tail, tail + 1, memory_order_release);
+            SDL_SemPost(s->space);
+        }
+    }
+
+    if (copied < len && !wav_stream_done(s))
+    {
+        s->starvations++;
+        s->starved_bytes += len - copied;
+    }
+    return copied;
+}
+
+int wav_stream_done(struct wav_stream *s)
+{
+    // eof is set after the last head update, so read it first
+    return atomic_load(&s->eof) && atomic_load(&s->head) == atomic_load(&s->tail);
+}
+
+void wav_stream_close(struct wav_stream *s)
+{
+    atomic_store(&s->quit, 1);
+    if (s->thread)
+    {
+        SDL_SemPost(s->space);
+        SDL_WaitThread(s->thread, NULL);
+    }
+    if (s->space)
+        SDL_DestroySemaphore(s->space);
+    if (s->fd >= 0)
+        close(s->fd);
+    SDL_free(s->pool);
+    SDL_zerop(s);
+    s->fd = -1;
+}
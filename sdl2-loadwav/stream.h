@@ -0,0 +1,68 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <SDL2/SDL.h>
+
+/*
+ * Constant-memory WAV playback.
+ *
+ * An I/O thread reads the data chunk ahead into a fixed pool of
+ * STREAM_CHUNKS buffers and hands them to the audio callback through a
+ * single-producer/single-consumer ring.  The callback only copies out of
+ * chunks that are already filled: when none is ready it counts a
+ * starvation and plays silence instead of waiting, so a stalled read never
+ * blocks the audio thread.
+ */
+#define STREAM_CHUNKS 8
+#define STREAM_CHUNK_BYTES (64 * 1024)
+// a read slower than this is counted as a stall
+#define STREAM_STALL_MS 20
+
+struct stream_chunk
+{
+    Uint8 *data;
+    Uint32 len;
+};
+
+struct wav_stream
+{
+    // constant after wav_stream_open()
+    int fd;
+    off_t data_offset;
+    Uint32 data_len;
+    SDL_AudioSpec spec;
+    Uint32 frame_size; // chunks and reads always hold whole frames of this many bytes
+    int read_delay_ms; // added to every read, to simulate slow storage
+    struct stream_chunk chunks[STREAM_CHUNKS];
+    Uint8 *pool;
+
+    // written by the I/O thread
+    atomic_uint head;
+    atomic_int eof;
+    Uint32 read_stalls;
+    double slowest_read_ms;
+
+    // written by the audio callback
+    atomic_uint tail;
+    Uint32 offset; // bytes already played of the chunk at tail
+    Uint32 starvations;
+    Uint32 starved_bytes;
+
+    SDL_Thread *thread;
+    SDL_sem *space; // posted whenever the callback frees a chunk
+    atomic_int quit;
+};
+
+/* returns 0 on success, -1 (see SDL_GetError()) on failure */
+int wav_stream_open(const char *file, struct wav_stream *s);
+/* start reading ahead and wait until the first chunk is ready */
+int wav_stream_start(struct wav_stream *s);
+/* audio thread: copy up to len bytes in whole frames, return how many were available */
+Uint32 wav_stream_read(struct wav_stream *s, Uint8 *dst, Uint32 len);
+/* everything has been read and played */
+int wav_stream_done(struct wav_stream *s);
+void wav_stream_close(struct wav_stream *s);
+
+#endif /* STREAM_H */
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "trace.h"
+
+void trace_init(struct trace *t)
+{
+    SDL_zerop(t);
+    atomic_init(&t->head, 0);
+    atomic_init(&t->tail, 0);
+    atomic_init(&t->lost, 0);
+}
+
+void trace_write(struct trace *t, const struct trace_record *r)
+{
+    const unsigned head = atomic_load_explicit(&t->head, memory_order_relaxed);
+
+    if (head - atomic_load_explicit(&t->tail, memory_order_acquire) == TRACE_RECORDS)
+    {
+        atomic_fetch_add_explicit(&t->lost, 1, memory_order_relaxed);
+        return;
+    }
+    t->records[head % TRACE_RECORDS] = *r;
+    atomic_store_explicit(&t->head, head + 1, memory_order_release);
+}
+
+int trace_read(struct trace *t, struct trace_record *r)
+{
+    const unsigned tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+
+    if (atomic_load_explicit(&t->head, memory_order_acquire) == tail)
+        return 0;
+    *r = t->records[tail % TRACE_RECORDS];
+    atomic_store_explicit(&t->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+void trace_histogram_add(struct trace_histogram *h, double us)
+{
+    int bin = 0;
+
+    while (bin < TRACE_BINS - 1 && us >= (double)(1u << bin))
+        bin++;
+    h->bins[bin]++;
+    h->count++;
+    h->sum_us += us;
+    if (us > h->max_us)
+        h->max_us = us;
+}
+
+void trace_histogram_print(const struct trace_histogram *h, const char *title)
+{
+    Uint32 peak = 1;
+    int first = TRACE_BINS, last = -1;
+
+    printf("%s: %u samples, mean %.1f us, max %.1f us\n", title, h->count,
+           h->count ? h->sum_us / h->count : 0.0, h->max_us);
+    for (int i = 0; i < TRACE_BINS; i++)
+    {
+        if (h->bins[i] == 0)
+            continue;
+        if (h->bins[i] > peak)
+            peak = h->bins[i];
+        if (first == TRACE_BINS)
+            first = i;
+        last = i;
+    }
+    for (int i = first; i <= last; i++)
+    {
+        char bar[41];
+        int width = (int)((Uint64)h->bins[i] * 40 / peak);
+
+        memset(bar, '#', width);
+        bar[width] = '\0';
+        if (i == 0)
+            printf("  %10s < %8u us %8u %s\n", "", 1u, h->bins[i], bar);
+        else if (i == TRACE_BINS - 1)
+            printf("  %10u+%14s%8u %s\n", 1u << (i - 1), "", h->bins[i], bar);
+        else
+            printf("  %10u - %8u us %8u %s\n", 1u << (i - 1), 1u << i, h->bins[i], bar);
+    }
+}
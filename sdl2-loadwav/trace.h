@@ -0,0 +1,59 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <SDL2/SDL.h>
+
+/*
+ * Real-time safe tracing for audio callbacks.
+ *
+ * The callback fills a fixed-size record and trace_write() copies it into a
+ * preallocated single-producer/single-consumer ring: no locks, no
+ * allocation, no I/O.  When the ring is full the record is dropped and
+ * counted.  The main thread drains it with trace_read() and does all the
+ * formatting.
+ */
+#define TRACE_RECORDS 1024 // a power of two
+
+struct trace_record
+{
+    Uint64 timestamp; // SDL_GetPerformanceCounter() when the callback started
+    Uint64 duration;  // counter ticks spent in the callback
+    const char *issued;
+    Uint32 event_count;
+    Sint32 len;
+    Uint32 loaded_len;
+};
+
+struct trace
+{
+    struct trace_record records[TRACE_RECORDS];
+    atomic_uint head; // written by the callback
+    atomic_uint tail; // written by the reader
+    atomic_uint lost;
+};
+
+/*
+ * Log2 histogram of microsecond values: bin 0 counts values below 1 us, bin
+ * i values in [2^(i-1), 2^i) us, the last bin everything above.
+ */
+#define TRACE_BINS 24
+
+struct trace_histogram
+{
+    Uint32 bins[TRACE_BINS];
+    Uint32 count;
+    double sum_us;
+    double max_us;
+};
+
+void trace_init(struct trace *t);
+/* audio thread */
+void trace_write(struct trace *t, const struct trace_record *r);
+/* reader: 1 if a record was copied into r, 0 if the ring is empty */
+int trace_read(struct trace *t, struct trace_record *r);
+
+void trace_histogram_add(struct trace_histogram *h, double us);
+void trace_histogram_print(const struct trace_histogram *h, const char *title);
+
+#endif /* TRACE_H */
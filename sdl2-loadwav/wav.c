@@ -0,0 +1,126 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wav.h"
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+// the header is not necessarily aligned inside the file
+static Uint16 le16(const Uint8 *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static Uint32 le32(const Uint8 *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((Uint32)p[3] << 24);
+}
+
+static SDL_AudioFormat wav_format(Uint16 tag, Uint16 bits)
+{
+    if (tag == WAVE_FORMAT_PCM && bits == 8)
+        return AUDIO_U8;
+    if (tag == WAVE_FORMAT_PCM && bits == 16)
+        return AUDIO_S16LSB;
+    if (tag == WAVE_FORMAT_PCM && bits == 32)
+        return AUDIO_S32LSB;
+    if (tag == WAVE_FORMAT_IEEE_FLOAT && bits == 32)
+        return AUDIO_F32LSB;
+    return 0;
+}
+
+int wav_map(const char *file, struct wav_map *wav)
+{
+    struct stat st;
+    int fd;
+
+    SDL_zerop(wav);
+    if ((fd = open(file, O_RDONLY)) < 0)
+        return SDL_SetError("open(\"%s\"): %s", file, strerror(errno));
+    if (fstat(fd, &st) < 0 || st.st_size < 12)
+    {
+        close(fd);
+        return SDL_SetError("\"%s\" is too short for a WAV file", file);
+    }
+    wav->map_size = st.st_size;
+    wav->map = mmap(NULL, wav->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (wav->map == MAP_FAILED)
+    {
+        wav->map = NULL;
+        return SDL_SetError("mmap(\"%s\"): %s", file, strerror(errno));
+    }
+
+    const Uint8 *p = wav->map, *end = p + wav->map_size;
+    Uint16 tag = 0, channels = 0, block_align = 0, bits = 0;
+    Uint32 freq = 0;
+
+    if (memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0)
+    {
+        wav_unmap(wav);
+        return SDL_SetError("\"%s\" is not a RIFF/WAVE file", file);
+    }
+
+    for (p += 12; end - p >= 8 && wav->data == NULL; )
+    {
+        const Uint32 size = le32(p + 4);
+        const Uint8 *body = p + 8;
+
+        if (memcmp(p, "fmt ", 4) == 0 && size >= 16 && end - body >= 16)
+        {
+            tag = le16(body);
+            channels = le16(body + 2);
+            freq = le32(body + 4);
+            block_align = le16(body + 12);
+            bits = le16(body + 14);
+            if (tag == WAVE_FORMAT_EXTENSIBLE && size >= 40 && end - body >= 40)
+                tag = le16(body + 24); // first two bytes of the SubFormat GUID
+        }
+        else if (memcmp(p, "data", 4) == 0 && tag != 0)
+        {
+            // a truncated file plays what is there
+            const size_t avail = end - body;
+            wav->data = (Uint8 *)body;
+            wav->data_len = (size < avail) ? size : (Uint32)avail;
+        }
+
+        if ((size_t)(end - body) < size)
+            break;
+        p = body + size + (size & 1); // chunks are padded to an even length
+    }
+
+    wav->spec.format = wav_format(tag, bits);
+    if (wav->data == NULL || wav->spec.format == 0 || channels == 0 || block_align == 0)
+    {
+        wav_unmap(wav);
+        return SDL_SetError("\"%s\": no data, or WAVE format 0x%04x with %d bits is not plain PCM",
+                            file, tag, bits);
+    }
+    // callers step through the data a frame at a time, so padding inside a frame is not supported
+    if (block_align != channels * (bits / 8))
+    {
+        wav_unmap(wav);
+        return SDL_SetError("\"%s\": block align %d does not match %d channels of %d bits",
+                            file, block_align, channels, bits);
+    }
+    wav->spec.freq = freq;
+    wav->spec.channels = channels;
+    wav->data_len -= wav->data_len % block_align;
+
+    // playback reads it front to back, once
+    madvise(wav->map, wav->map_size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void wav_unmap(struct wav_map *wav)
+{
+    if (wav->map)
+        munmap(wav->map, wav->map_size);
+    SDL_zerop(wav);
+}
@@ -0,0 +1,27 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * A WAV file mapped read-only into memory.
+ *
+ * wav_map() parses the RIFF header in place; data points at the samples
+ * inside the mapping, so nothing is read or copied until the pages are
+ * touched.  Only formats SDL can play without decoding are accepted: 8, 16
+ * and 32 bit integer PCM and 32 bit float, including WAVE_FORMAT_EXTENSIBLE.
+ */
+struct wav_map
+{
+    void *map;
+    size_t map_size;
+    SDL_AudioSpec spec; /* freq, format and channels of the data */
+    Uint8 *data;        /* first sample, inside map */
+    Uint32 data_len;    /* bytes, a whole number of frames */
+};
+
+/* returns 0 on success, -1 (see SDL_GetError()) on failure */
+int wav_map(const char *file, struct wav_map *wav);
+void wav_unmap(struct wav_map *wav);
+
+#endif /* WAV_H */
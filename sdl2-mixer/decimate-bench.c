@@ -0,0 +1,88 @@
+/* Microbenchmark for the waveform decimation kernels in decimate.h.
+ *
+ * Every kernel the CPU supports is checked against the scalar kernel and
+ * then timed on a synthetic stereo signal for several block lengths, all
+ * reduced to W columns.
+ *
+ * usage: decimate-bench [columns]
+ */
+#include <SDL2/SDL.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "decimate.h"
+
+#define W 640
+#define MAX_FRAMES (1 << 20)
+/* minimum time spent on each kernel/length pair */
+#define RUN_SECONDS 0.25
+
+static Sint16 frames[MAX_FRAMES * 2];
+static struct envelope env[MAX_FRAMES];
+static struct envelope ref[MAX_FRAMES];
+
+int main(int argc, char **argv)
+{
+    const int columns = (argc > 1) ? atoi(argv[1]) : W;
+    if (columns <= 0 || columns > MAX_FRAMES)
+    {
+        fprintf(stderr, "Usage: %s [columns]\n", *argv);
+        return 1;
+    }
+
+    /* deterministic noise, full Sint16 range */
+    Uint32 seed = 1;
+    for (int i = 0; i < MAX_FRAMES * 2; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        frames[i] = (Sint16)(seed >> 16);
+    }
+
+    static const int lengths[] = {1024, 4096, 16384, 65536, MAX_FRAMES};
+    const double freq = (double)SDL_GetPerformanceFrequency();
+
+    printf("%-8s %10s %8s %14s\n", "kernel", "frames", "columns", "samples/sec");
+    for (int k = 0; k < DECIMATE_KERNELS; k++)
+    {
+        const struct decimate_kernel *kernel = &decimate_kernels[k];
+        if (kernel->supported != NULL && !kernel->supported())
+        {
+            printf("%-8s (not supported by this CPU)\n", kernel->name);
+            continue;
+        }
+
+        for (int l = 0; l < (int)SDL_arraysize(lengths); l++)
+        {
+            const int n = lengths[l];
+
+            decimate_scalar(frames, n, columns, ref);
+            kernel->fn(frames, n, columns, env);
+            if (memcmp(ref, env, columns * sizeof(*env)) != 0)
+            {
+                printf("%-8s %10d %8d   MISMATCH with scalar kernel\n", kernel->name, n, columns);
+                return 1;
+            }
+
+            Uint64 iterations = 0;
+            const Uint64 start = SDL_GetPerformanceCounter();
+            Uint64 now;
+            do
+            {
+                for (int i = 0; i < 16; i++)
+                {
+                    kernel->fn(frames, n, columns, env);
+                }
+                iterations += 16;
+                now = SDL_GetPerformanceCounter();
+            } while ((now - start) / freq < RUN_SECONDS);
+
+            const double seconds = (now - start) / freq;
+            printf("%-8s %10d %8d %14.0f\n", kernel->name, n, columns,
+                   (double)iterations * n * 2 / seconds);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,263 @@
+/* Min/max peak decimation of interleaved stereo Sint16 audio.
+ *
+ * A decimate_fn reduces a block of any length to one min/max pair per channel
+ * for each of `columns` display columns, so every sample of the block is
+ * accounted for no matter how the block length compares to the window
+ * width.  Column c covers frames [c * nframes / columns, (c + 1) * nframes /
+ * columns); when there are fewer frames than columns a column repeats the
+ * nearest frame.
+ *
+ * Kernels exist for SSE2, AVX2 and NEON plus a scalar fallback;
+ * decimate_select() picks the best one the running CPU supports.
+ */
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <SDL2/SDL.h>
+
+#ifdef __SSE2__
+#define DECIMATE_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && defined(__SSE2__)
+#define DECIMATE_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DECIMATE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* envelope of one column: index 0 is the left channel, 1 the right */
+struct envelope
+{
+    Sint16 min[2];
+    Sint16 max[2];
+};
+
+typedef void (*decimate_fn)(const Sint16 *frames, int nframes, int columns,
+                            struct envelope *env);
+
+struct decimate_kernel
+{
+    const char *name;
+    decimate_fn fn;
+    SDL_bool (*supported)(void); /* NULL: always available */
+};
+
+static inline void decimate_column(int c, int nframes, int columns, int *start, int *end)
+{
+    *start = (int)((Sint64)c * nframes / columns);
+    *end = (int)((Sint64)(c + 1) * nframes / columns);
+    if (*end <= *start)
+    {
+        *end = *start + 1;
+    }
+}
+
+/* reduce frames [i, n) of p into e, which already holds at least one frame */
+static inline void decimate_tail(const Sint16 *p, int i, int n, struct envelope *e)
+{
+    for (; i < n; i++)
+    {
+        for (int ch = 0; ch < 2; ch++)
+        {
+            const Sint16 s = p[2 * i + ch];
+            if (s < e->min[ch])
+            {
+                e->min[ch] = s;
+            }
+            if (s > e->max[ch])
+            {
+                e->max[ch] = s;
+            }
+        }
+    }
+}
+
+static void decimate_scalar(const Sint16 *frames, int nframes, int columns,
+                            struct envelope *env)
+{
+    for (int c = 0; c < columns; c++)
+    {
+        int start, end;
+        decimate_column(c, nframes, columns, &start, &end);
+
+        const Sint16 *p = frames + 2 * start;
+        struct envelope *e = &env[c];
+        e->min[0] = e->max[0] = p[0];
+        e->min[1] = e->max[1] = p[1];
+        decimate_tail(p, 1, end - start, e);
+    }
+}
+
+#ifdef DECIMATE_SSE2
+/* Each 32-bit lane holds one (left, right) frame, so folding lanes with
+ * 32-bit shuffles keeps the two channels apart. */
+static inline void decimate_fold_sse2(__m128i vmin, __m128i vmax, struct envelope *e)
+{
+    vmin = _mm_min_epi16(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmin = _mm_min_epi16(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(2, 3, 0, 1)));
+    vmax = _mm_max_epi16(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmax = _mm_max_epi16(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    const Uint32 mn = (Uint32)_mm_cvtsi128_si32(vmin);
+    const Uint32 mx = (Uint32)_mm_cvtsi128_si32(vmax);
+    e->min[0] = (Sint16)(mn & 0xFFFF);
+    e->min[1] = (Sint16)(mn >> 16);
+    e->max[0] = (Sint16)(mx & 0xFFFF);
+    e->max[1] = (Sint16)(mx >> 16);
+}
+
+static void decimate_sse2(const Sint16 *frames, int nframes, int columns,
+                          struct envelope *env)
+{
+    for (int c = 0; c < columns; c++)
+    {
+        int start, end;
+        decimate_column(c, nframes, columns, &start, &end);
+
+        const Sint16 *p = frames + 2 * start;
+        const int n = end - start;
+        struct envelope *e = &env[c];
+        int i;
+
+        if (n >= 4)
+        {
+            __m128i vmin = _mm_loadu_si128((const __m128i *)p);
+            __m128i vmax = vmin;
+            for (i = 4; i + 4 <= n; i += 4)
+            {
+                const __m128i v = _mm_loadu_si128((const __m128i *)(p + 2 * i));
+                vmin = _mm_min_epi16(vmin, v);
+                vmax = _mm_max_epi16(vmax, v);
+            }
+            decimate_fold_sse2(vmin, vmax, e);
+        }
+        else
+        {
+            e->min[0] = e->max[0] = p[0];
+            e->min[1] = e->max[1] = p[1];
+            i = 1;
+        }
+        decimate_tail(p, i, n, e);
+    }
+}
+#endif
+
+#ifdef DECIMATE_AVX2
+__attribute__((target("avx2"))) static void decimate_avx2(const Sint16 *frames, int nframes,
+                                                          int columns, struct envelope *env)
+{
+    for (int c = 0; c < columns; c++)
+    {
+        int start, end;
+        decimate_column(c, nframes, columns, &start, &end);
+
+        const Sint16 *p = frames + 2 * start;
+        const int n = end - start;
+        struct envelope *e = &env[c];
+        int i;
+
+        if (n >= 8)
+        {
+            __m256i vmin = _mm256_loadu_si256((const __m256i *)p);
+            __m256i vmax = vmin;
+            for (i = 8; i + 8 <= n; i += 8)
+            {
+                const __m256i v = _mm256_loadu_si256((const __m256i *)(p + 2 * i));
+                vmin = _mm256_min_epi16(vmin, v);
+                vmax = _mm256_max_epi16(vmax, v);
+            }
+            const __m128i min128 = _mm_min_epi16(_mm256_castsi256_si128(vmin),
+                                           _mm256_extracti128_si256(vmin, 1));
+            const __m128i max128 = _mm_max_epi16(_mm256_castsi256_si128(vmax),
+                                           _mm256_extracti128_si256(vmax, 1));
+            decimate_fold_sse2(min128, max128, e);
+        }
+        else
+        {
+            e->min[0] = e->max[0] = p[0];
+            e->min[1] = e->max[1] = p[1];
+            i = 1;
+        }
+        decimate_tail(p, i, n, e);
+    }
+}
+#endif
+
+#ifdef DECIMATE_NEON
+static void decimate_neon(const Sint16 *frames, int nframes, int columns,
+                          struct envelope *env)
+{
+    for (int c = 0; c < columns; c++)
+    {
+        int start, end;
+        decimate_column(c, nframes, columns, &start, &end);
+
+        const Sint16 *p = frames + 2 * start;
+        const int n = end - start;
+        struct envelope *e = &env[c];
+        int i;
+
+        if (n >= 4)
+        {
+            int16x8_t vmin = vld1q_s16(p);
+            int16x8_t vmax = vmin;
+            for (i = 4; i + 4 <= n; i += 4)
+            {
+                const int16x8_t v = vld1q_s16(p + 2 * i);
+                vmin = vminq_s16(vmin, v);
+                vmax = vmaxq_s16(vmax, v);
+            }
+            /* L R L R -> swap the two (L, R) pairs and fold again */
+            int16x4_t min4 = vmin_s16(vget_low_s16(vmin), vget_high_s16(vmin));
+            int16x4_t max4 = vmax_s16(vget_low_s16(vmax), vget_high_s16(vmax));
+            min4 = vmin_s16(min4, vreinterpret_s16_s32(vrev64_s32(vreinterpret_s32_s16(min4))));
+            max4 = vmax_s16(max4, vreinterpret_s16_s32(vrev64_s32(vreinterpret_s32_s16(max4))));
+
+            e->min[0] = vget_lane_s16(min4, 0);
+            e->min[1] = vget_lane_s16(min4, 1);
+            e->max[0] = vget_lane_s16(max4, 0);
+            e->max[1] = vget_lane_s16(max4, 1);
+        }
+        else
+        {
+            e->min[0] = e->max[0] = p[0];
+            e->min[1] = e->max[1] = p[1];
+            i = 1;
+        }
+        decimate_tail(p, i, n, e);
+    }
+}
+#endif
+
+/* best first; the scalar kernel must stay last */
+static const struct decimate_kernel decimate_kernels[] = {
+#ifdef DECIMATE_AVX2
+    {"avx2", decimate_avx2, SDL_HasAVX2},
+#endif
+#ifdef DECIMATE_SSE2
+    {"sse2", decimate_sse2, SDL_HasSSE2},
+#endif
+#ifdef DECIMATE_NEON
+    {"neon", decimate_neon, SDL_HasNEON},
+#endif
+    {"scalar", decimate_scalar, NULL},
+};
+
+#define DECIMATE_KERNELS ((int)(sizeof(decimate_kernels) / sizeof(decimate_kernels[0])))
+
+static inline const struct decimate_kernel *decimate_select(void)
+{
+    for (int i = 0; i < DECIMATE_KERNELS; i++)
+    {
+        if (decimate_kernels[i].supported == NULL || decimate_kernels[i].supported())
+        {
+            return &decimate_kernels[i];
+        }
+    }
+    return &decimate_kernels[DECIMATE_KERNELS - 1];
+}
+
+#endif /* DECIMATE_H */
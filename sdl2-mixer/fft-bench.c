@@ -0,0 +1,107 @@
+/* Benchmark for the spectrum analyzer FFT in fft.h.
+ *
+ * The transform is first checked against a direct DFT, then timed at
+ * 1k to 16k points on windowed noise.
+ *
+ * usage: fft-bench
+ */
+#include <SDL2/SDL.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "fft.h"
+
+#define MIN_SIZE 1024
+#define MAX_SIZE 16384
+#define CHECK_SIZE 1024
+/* minimum time spent on each size */
+#define RUN_SECONDS 0.5
+
+static float input[MAX_SIZE];
+static float power[MAX_SIZE / 2 + 1];
+
+/* largest error against a direct DFT, relative to the largest bin */
+static double check(struct fft *f)
+{
+    double max_error = 0.0, max_power = 0.0;
+
+    fft_power(f, input, power);
+    for (int k = 0; k <= f->n / 2; k++)
+    {
+        double re = 0.0, im = 0.0;
+        for (int i = 0; i < f->n; i++)
+        {
+            const double v = input[i] * f->hann[i];
+            re += v * cos(2.0 * M_PI * k * i / f->n);
+            im -= v * sin(2.0 * M_PI * k * i / f->n);
+        }
+        const double p = re * re + im * im;
+        if (fabs(p - power[k]) > max_error)
+        {
+            max_error = fabs(p - power[k]);
+        }
+        if (p > max_power)
+        {
+            max_power = p;
+        }
+    }
+
+    return max_error / max_power;
+}
+
+int main(int argc, char **argv)
+{
+    Uint32 seed = 1;
+    for (int i = 0; i < MAX_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        input[i] = (Sint16)(seed >> 16) / 32768.0f;
+    }
+
+    struct fft f;
+    if (fft_init(&f, CHECK_SIZE) < 0)
+    {
+        fprintf(stderr, "fft_init: %s\n", SDL_GetError());
+        return 1;
+    }
+    const double error = check(&f);
+    fft_free(&f);
+    printf("%d-point check against direct DFT: relative error %.2e\n", CHECK_SIZE, error);
+    if (error > 1e-4)
+    {
+        return 1;
+    }
+
+    const double freq = (double)SDL_GetPerformanceFrequency();
+
+    printf("%8s %16s %14s\n", "points", "transforms/sec", "us/transform");
+    for (int n = MIN_SIZE; n <= MAX_SIZE; n *= 2)
+    {
+        if (fft_init(&f, n) < 0)
+        {
+            fprintf(stderr, "fft_init(%d): %s\n", n, SDL_GetError());
+            return 1;
+        }
+
+        Uint64 transforms = 0;
+        const Uint64 start = SDL_GetPerformanceCounter();
+        Uint64 now;
+        do
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                fft_power(&f, input, power);
+            }
+            transforms += 8;
+            now = SDL_GetPerformanceCounter();
+        } while ((now - start) / freq < RUN_SECONDS);
+
+        const double seconds = (now - start) / freq;
+        printf("%8d %16.0f %14.2f\n", n, transforms / seconds, seconds * 1e6 / transforms);
+        fft_free(&f);
+    }
+
+    return 0;
+}
@@ -0,0 +1,159 @@
+/* Windowed real-input FFT for the spectrum analyzer.
+ *
+ * n real samples are packed into n / 2 complex values and transformed with an
+ * iterative radix-2 FFT; a final split pass recovers the n / 2 + 1 bins of the
+ * real spectrum.  The Hann window, the bit-reversal permutation and both
+ * twiddle tables are computed once in fft_init(), so fft_power() does no
+ * trigonometry and no allocation.
+ */
+#ifndef FFT_H
+#define FFT_H
+
+#include <math.h>
+
+#include <SDL2/SDL.h>
+
+struct fft
+{
+    int n;          /* real input length, a power of two */
+    int m;          /* n / 2, length of the complex transform */
+    float window;   /* sum of the window coefficients */
+    float *hann;    /* n window coefficients */
+    float *twiddle; /* m / 2 complex e^(-2 pi i k / m), interleaved re, im */
+    float *split;   /* m complex e^(-2 pi i k / n), interleaved re, im */
+    int *bitrev;    /* m bit-reversed indices */
+    float *work;    /* m complex values, interleaved re, im */
+};
+
+static inline void fft_free(struct fft *f)
+{
+    SDL_free(f->hann);
+    SDL_free(f->twiddle);
+    SDL_free(f->split);
+    SDL_free(f->bitrev);
+    SDL_free(f->work);
+    SDL_memset(f, 0, sizeof(*f));
+}
+
+/* n must be a power of two, at least 4. Returns 0 on success, -1 on failure. */
+static inline int fft_init(struct fft *f, int n)
+{
+    SDL_memset(f, 0, sizeof(*f));
+    if (n < 4 || (n & (n - 1)) != 0)
+    {
+        return SDL_SetError("FFT size %d is not a power of two", n);
+    }
+
+    const int m = n / 2;
+    f->n = n;
+    f->m = m;
+    f->hann = SDL_malloc(n * sizeof(float));
+    f->twiddle = SDL_malloc(m * sizeof(float));
+    f->split = SDL_malloc(2 * m * sizeof(float));
+    f->bitrev = SDL_malloc(m * sizeof(int));
+    f->work = SDL_malloc(2 * m * sizeof(float));
+    if (!f->hann || !f->twiddle || !f->split || !f->bitrev || !f->work)
+    {
+        fft_free(f);
+        return SDL_SetError("out of memory");
+    }
+
+    f->window = 0.0f;
+    for (int i = 0; i < n; i++)
+    {
+        f->hann[i] = 0.5f - 0.5f * (float)cos(2.0 * M_PI * i / n);
+        f->window += f->hann[i];
+    }
+
+    for (int k = 0; k < m / 2; k++)
+    {
+        f->twiddle[2 * k] = (float)cos(2.0 * M_PI * k / m);
+        f->twiddle[2 * k + 1] = (float)-sin(2.0 * M_PI * k / m);
+    }
+
+    for (int k = 0; k < m; k++)
+    {
+        f->split[2 * k] = (float)cos(2.0 * M_PI * k / n);
+        f->split[2 * k + 1] = (float)-sin(2.0 * M_PI * k / n);
+    }
+
+    int bits = 0;
+    while ((1 << bits) < m)
+    {
+        bits++;
+    }
+    for (int k = 0; k < m; k++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+        {
+            r |= ((k >> b) & 1) << (bits - 1 - b);
+        }
+        f->bitrev[k] = r;
+    }
+
+    return 0;
+}
+
+/* Power spectrum of the n samples in `in`, after windowing.
+ * power receives n / 2 + 1 values, |X[k]|^2 for k = 0 .. n / 2. */
+static inline void fft_power(struct fft *f, const float *in, float *power)
+{
+    const int m = f->m;
+    float *z = f->work;
+
+    /* window and pack even/odd samples as re/im, in bit-reversed order */
+    for (int k = 0; k < m; k++)
+    {
+        float *dst = &z[2 * f->bitrev[k]];
+        dst[0] = in[2 * k] * f->hann[2 * k];
+        dst[1] = in[2 * k + 1] * f->hann[2 * k + 1];
+    }
+
+    for (int size = 2; size <= m; size <<= 1)
+    {
+        const int half = size >> 1;
+        const int step = m / size;
+        for (int start = 0; start < m; start += size)
+        {
+            for (int j = 0; j < half; j++)
+            {
+                const float wr = f->twiddle[2 * j * step];
+                const float wi = f->twiddle[2 * j * step + 1];
+                float *a = &z[2 * (start + j)];
+                float *b = &z[2 * (start + j + half)];
+                const float tr = b[0] * wr - b[1] * wi;
+                const float ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+
+    /* split the packed transform into the spectrum of the real input */
+    for (int k = 0; k <= m; k++)
+    {
+        const float *za = &z[2 * (k % m)];
+        const float *zb = &z[2 * ((m - k) % m)];
+        const float er = 0.5f * (za[0] + zb[0]);
+        const float ei = 0.5f * (za[1] - zb[1]);
+        const float dr = 0.5f * (za[0] - zb[0]);
+        const float di = 0.5f * (za[1] + zb[1]);
+        const float wr = (k < m) ? f->split[2 * k] : -1.0f;
+        const float wi = (k < m) ? f->split[2 * k + 1] : 0.0f;
+        const float xr = er + di * wr + dr * wi;
+        const float xi = ei + di * wi - dr * wr;
+        power[k] = xr * xr + xi * xi;
+    }
+}
+
+/* dB relative to a full-scale sine (amplitude 1.0) for a value of fft_power() */
+static inline float fft_db(const struct fft *f, float power)
+{
+    const float scale = 2.0f / f->window;
+    return 10.0f * log10f(power * scale * scale + 1e-20f);
+}
+
+#endif /* FFT_H */
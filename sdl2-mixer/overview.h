@@ -0,0 +1,515 @@
+/* Whole-track waveform overview.
+ *
+ * A min/max pyramid: level 0 holds one struct envelope per OVERVIEW_BASE
+ * frames of the song and every level above it halves the one below, down to
+ * a single bucket.  Drawing any width then reads at most two buckets per
+ * column from the coarsest level that is still wide enough.
+ *
+ * overview_start() first looks for a sidecar <file>.ovw written by an earlier
+ * run and maps it read-only, so a file seen before costs one mmap().
+ * Otherwise a worker thread builds it.  A PCM or float WAV is read
+ * OVERVIEW_READ bytes at a time and converted through an SDL_AudioStream, so
+ * memory stays bounded and the strip grows while the file is still being
+ * read; SDL_mixer has no incremental decoder for other formats, so those
+ * come from Mix_LoadWAV_RW and are then converted the same way.  Level 0 is
+ * filled front to back a slice at a time and every slice publishes how many
+ * frames it covers in `ready`, so the strip can be drawn while it grows.  The
+ * finished pyramid is saved as the sidecar.
+ */
+#ifndef OVERVIEW_H
+#define OVERVIEW_H
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_mixer.h>
+
+#include "decimate.h"
+
+#define OVERVIEW_MAGIC 0x3257564fu /* "OVW2" */
+/* the pyramid is built from stereo Sint16, one envelope channel each */
+#define OVERVIEW_CHANNELS 2
+/* frames per level 0 bucket */
+#define OVERVIEW_BASE 512
+#define OVERVIEW_LEVELS 40
+/* level 0 buckets built between two updates of `ready`, about 3 s of song */
+#define OVERVIEW_SLICE 256
+/* bytes of WAV data read at a time */
+#define OVERVIEW_READ 65536
+
+/* sidecar layout: this header, then every level from 0 up, back to back */
+struct overview_header
+{
+    Uint32 magic;
+    Uint32 rate;     /* the song was decoded at this rate, */
+    Uint32 channels; /* to this many Sint16 channels */
+    Uint32 base;
+    Uint32 levels;
+    Uint64 source_size;
+    Sint64 source_mtime;
+    Sint64 frames;
+};
+
+struct overview
+{
+    char path[1024]; /* the song */
+    int rate;
+    decimate_fn decimate;
+    Uint64 source_size;
+    Sint64 source_mtime;
+
+    SDL_Thread *thread;
+    atomic_int quit;
+    atomic_llong ready; /* frames covered by every level; frames when complete */
+
+    /* set before ready becomes non-zero */
+    Sint64 frames;
+    int levels;
+    Sint64 count[OVERVIEW_LEVELS]; /* buckets per level */
+    struct envelope *level[OVERVIEW_LEVELS];
+
+    void *map; /* sidecar mapping, or NULL */
+    size_t map_size;
+    struct envelope *storage; /* pyramid built by the worker, or NULL */
+    int cached;               /* came from the sidecar */
+};
+
+/* fill in frames, levels and count[]; returns the total number of buckets */
+static inline Sint64 overview_layout(struct overview *o, Sint64 frames)
+{
+    Sint64 total = 0;
+    Sint64 count = (frames + OVERVIEW_BASE - 1) / OVERVIEW_BASE;
+
+    o->frames = frames;
+    o->levels = 0;
+    while (count > 0 && o->levels < OVERVIEW_LEVELS)
+    {
+        o->count[o->levels++] = count;
+        total += count;
+        if (count == 1)
+        {
+            break;
+        }
+        count = (count + 1) / 2;
+    }
+    return total;
+}
+
+static inline void overview_point_levels(struct overview *o, struct envelope *first)
+{
+    for (int k = 0; k < o->levels; k++)
+    {
+        o->level[k] = first;
+        first += o->count[k];
+    }
+}
+
+static inline void overview_sidecar(const struct overview *o, char *path, size_t size,
+                                    const char *suffix)
+{
+    SDL_snprintf(path, size, "%s.ovw%s", o->path, suffix);
+}
+
+/* map a sidecar that matches the song; 0 on success, -1 if there is none */
+static inline int overview_map(struct overview *o)
+{
+    char path[sizeof(o->path) + 16];
+    overview_sidecar(o, path, sizeof(path), "");
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct overview_header))
+    {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    const struct overview_header *h = map;
+    const Sint64 total = (h->magic == OVERVIEW_MAGIC && h->frames > 0) ? overview_layout(o, h->frames) : 0;
+    if (total == 0 || h->rate != (Uint32)o->rate || h->channels != OVERVIEW_CHANNELS ||
+        h->base != OVERVIEW_BASE ||
+        h->levels != (Uint32)o->levels || h->source_size != o->source_size ||
+        h->source_mtime != o->source_mtime ||
+        (size_t)st.st_size != sizeof(*h) + total * sizeof(struct envelope))
+    {
+        // stale or foreign: rebuild and overwrite it
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    overview_point_levels(o, (struct envelope *)(h + 1));
+    o->map = map;
+    o->map_size = st.st_size;
+    o->cached = 1;
+    atomic_store_explicit(&o->ready, o->frames, memory_order_release);
+    return 0;
+}
+
+/* write the finished pyramid next to the song; failures are not fatal */
+static inline void overview_save(const struct overview *o, Sint64 total)
+{
+    char path[sizeof(o->path) + 16], tmp[sizeof(o->path) + 16];
+    overview_sidecar(o, path, sizeof(path), "");
+    overview_sidecar(o, tmp, sizeof(tmp), ".tmp");
+
+    const struct overview_header h = {OVERVIEW_MAGIC, o->rate, OVERVIEW_CHANNELS, OVERVIEW_BASE, o->levels,
+                                      o->source_size, o->source_mtime, o->frames};
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL)
+    {
+        return;
+    }
+    const int ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+                   fwrite(o->storage, sizeof(struct envelope), total, f) == (size_t)total;
+    if (fclose(f) == 0 && ok)
+    {
+        rename(tmp, path);
+    }
+    else
+    {
+        remove(tmp);
+    }
+}
+
+static inline void overview_merge(const struct envelope *a, const struct envelope *b,
+                                  struct envelope *e)
+{
+    for (int ch = 0; ch < 2; ch++)
+    {
+        e->min[ch] = (b != NULL && b->min[ch] < a->min[ch]) ? b->min[ch] : a->min[ch];
+        e->max[ch] = (b != NULL && b->max[ch] > a->max[ch]) ? b->max[ch] : a->max[ch];
+    }
+}
+
+/* Add `frames` stereo frames, starting at bucket done[0], to level 0, merge
+ * every bucket above whose children are now complete and publish the
+ * progress.  frames is a multiple of OVERVIEW_BASE except at the end. */
+static inline void overview_add(struct overview *o, Sint64 *done, const Sint16 *samples, int frames)
+{
+    const int full = frames / OVERVIEW_BASE;
+    int buckets = full;
+    if (full > 0)
+    {
+        o->decimate(samples, full * OVERVIEW_BASE, full, &o->level[0][done[0]]);
+    }
+    if (full * OVERVIEW_BASE < frames)
+    {
+        // short last bucket
+        o->decimate(samples + OVERVIEW_CHANNELS * full * OVERVIEW_BASE, frames - full * OVERVIEW_BASE, 1,
+                    &o->level[0][done[0] + full]);
+        buckets++;
+    }
+    done[0] += buckets;
+
+    for (int k = 1; k < o->levels; k++)
+    {
+        const Sint64 below = o->count[k - 1];
+        const Sint64 target = (done[k - 1] == below) ? o->count[k] : done[k - 1] / 2;
+        for (Sint64 j = done[k]; j < target; j++)
+        {
+            overview_merge(&o->level[k - 1][2 * j],
+                           (2 * j + 1 < below) ? &o->level[k - 1][2 * j + 1] : NULL,
+                           &o->level[k][j]);
+        }
+        done[k] = target;
+    }
+
+    atomic_store_explicit(&o->ready, (done[0] == o->count[0]) ? o->frames : done[0] * OVERVIEW_BASE,
+                          memory_order_release);
+}
+
+/* The song's samples as the worker reads them: straight from the data chunk
+ * of a WAV, or from a chunk SDL_mixer decoded whole. */
+struct overview_source
+{
+    SDL_RWops *rw; /* at the WAV data, or NULL */
+    Mix_Chunk *chunk;
+    SDL_AudioFormat format;
+    int channels;
+    int rate;
+    Sint64 bytes; /* of sample data, whole frames */
+};
+
+/* Find the format and data of a PCM or float WAV SDL_AudioStream can take and
+ * leave rw at the start of the data; 0 on success, -1 for anything else. */
+static inline int overview_wav(SDL_RWops *rw, struct overview_source *src)
+{
+    char id[4];
+    int have_fmt = 0;
+
+    if (SDL_RWread(rw, id, 4, 1) != 1 || SDL_memcmp(id, "RIFF", 4) != 0)
+    {
+        return -1;
+    }
+    SDL_ReadLE32(rw);
+    if (SDL_RWread(rw, id, 4, 1) != 1 || SDL_memcmp(id, "WAVE", 4) != 0)
+    {
+        return -1;
+    }
+
+    while (SDL_RWread(rw, id, 4, 1) == 1)
+    {
+        const Uint32 size = SDL_ReadLE32(rw);
+        if (SDL_memcmp(id, "fmt ", 4) == 0 && size >= 16)
+        {
+            Uint16 tag = SDL_ReadLE16(rw);
+            const int channels = SDL_ReadLE16(rw);
+            const int rate = (int)SDL_ReadLE32(rw);
+            SDL_ReadLE32(rw); /* byte rate */
+            const int align = SDL_ReadLE16(rw);
+            const int bits = SDL_ReadLE16(rw);
+            Uint32 read = 16;
+            if (tag == 0xFFFE && size >= 40)
+            {
+                // WAVE_FORMAT_EXTENSIBLE: the real tag opens the subformat GUID
+                SDL_ReadLE32(rw); /* cbSize, valid bits */
+                SDL_ReadLE32(rw); /* channel mask */
+                tag = SDL_ReadLE16(rw);
+                read = 26;
+            }
+            if (SDL_RWseek(rw, size - read + (size & 1), RW_SEEK_CUR) < 0)
+            {
+                return -1;
+            }
+
+            if (tag == 1 && bits == 8)
+            {
+                src->format = AUDIO_U8;
+            }
+            else if (tag == 1 && bits == 16)
+            {
+                src->format = AUDIO_S16LSB;
+            }
+            else if (tag == 1 && bits == 32)
+            {
+                src->format = AUDIO_S32LSB;
+            }
+            else if (tag == 3 && bits == 32)
+            {
+                src->format = AUDIO_F32LSB;
+            }
+            else
+            {
+                return -1;
+            }
+            if (channels < 1 || channels > 8 || rate <= 0 || align != channels * bits / 8)
+            {
+                return -1;
+            }
+            src->channels = channels;
+            src->rate = rate;
+            have_fmt = 1;
+        }
+        else if (SDL_memcmp(id, "data", 4) == 0 && have_fmt)
+        {
+            // a streaming writer may leave the size unset: take the rest of the file
+            const Sint64 rest = SDL_RWsize(rw) - SDL_RWtell(rw);
+            const Sint64 bytes = (size == 0 || size == 0xFFFFFFFF || size > rest) ? rest : size;
+            const int frame = SDL_AUDIO_BITSIZE(src->format) / 8 * src->channels;
+            src->bytes = bytes / frame * frame;
+            src->rw = rw;
+            return src->bytes > 0 ? 0 : -1;
+        }
+        else if (SDL_RWseek(rw, size + (size & 1), RW_SEEK_CUR) < 0)
+        {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/* Worker: read the song, build the pyramid a slice at a time, save it. */
+static int overview_thread(void *data)
+{
+    struct overview *o = data;
+    struct overview_source src;
+    SDL_AudioStream *stream = NULL;
+    Sint16 *block = NULL;
+    Uint8 *in = NULL;
+    Sint64 total = 0;
+    Sint64 done[OVERVIEW_LEVELS] = {0};
+
+    SDL_memset(&src, 0, sizeof(src));
+    SDL_RWops *rw = SDL_RWFromFile(o->path, "rb");
+    if (rw == NULL)
+    {
+        return 0;
+    }
+    if (overview_wav(rw, &src) < 0)
+    {
+        SDL_AudioFormat format;
+        SDL_RWseek(rw, 0, RW_SEEK_SET);
+        // freed by the mixer, loaded or not
+        src.chunk = Mix_LoadWAV_RW(rw, 1);
+        rw = NULL;
+        if (src.chunk == NULL || Mix_QuerySpec(&src.rate, &format, &src.channels) == 0)
+        {
+            goto done;
+        }
+        // the mixer converted it to the device format
+        src.format = format;
+        src.bytes = src.chunk->alen / (SDL_AUDIO_BITSIZE(format) / 8 * src.channels) *
+                    (SDL_AUDIO_BITSIZE(format) / 8 * src.channels);
+    }
+
+    const int frame_bytes = SDL_AUDIO_BITSIZE(src.format) / 8 * src.channels;
+    const int read_bytes = OVERVIEW_READ / frame_bytes * frame_bytes;
+    const int block_frames = OVERVIEW_SLICE * OVERVIEW_BASE;
+    const int out_frame = OVERVIEW_CHANNELS * sizeof(Sint16);
+
+    // the frame count the resampler will produce, give or take a few
+    total = overview_layout(o, (src.bytes / frame_bytes * o->rate + src.rate - 1) / src.rate);
+    o->storage = (total > 0) ? SDL_malloc(total * sizeof(struct envelope)) : NULL;
+    stream = SDL_NewAudioStream(src.format, src.channels, src.rate, AUDIO_S16SYS, OVERVIEW_CHANNELS, o->rate);
+    block = SDL_malloc((size_t)block_frames * out_frame);
+    in = src.rw != NULL ? SDL_malloc(read_bytes) : NULL;
+    if (o->storage == NULL || stream == NULL || block == NULL || (src.rw != NULL && in == NULL))
+    {
+        goto done;
+    }
+    overview_point_levels(o, o->storage);
+
+    Sint64 fed = 0;
+    int flushed = 0;
+    while (done[0] < o->count[0] && !atomic_load(&o->quit))
+    {
+        const int want = (int)SDL_min(block_frames, o->frames - done[0] * OVERVIEW_BASE);
+        int have = 0;
+        while (have < want)
+        {
+            const int got = SDL_AudioStreamGet(stream, block + OVERVIEW_CHANNELS * have, (want - have) * out_frame);
+            if (got < 0)
+            {
+                goto done;
+            }
+            if (got > 0)
+            {
+                have += got / out_frame;
+                continue;
+            }
+            if (flushed)
+            {
+                // the resampler came out a few frames short of the estimate
+                SDL_memset(block + OVERVIEW_CHANNELS * have, 0, (size_t)(want - have) * out_frame);
+                have = want;
+                break;
+            }
+
+            int n = (int)SDL_min(read_bytes, src.bytes - fed);
+            if (n > 0 && src.rw != NULL)
+            {
+                // a file cut short ends the song at the last whole frame
+                n = (int)SDL_RWread(src.rw, in, 1, n) / frame_bytes * frame_bytes;
+            }
+            if (n > 0)
+            {
+                SDL_AudioStreamPut(stream, src.rw != NULL ? in : src.chunk->abuf + fed, n);
+                fed += n;
+            }
+            else
+            {
+                SDL_AudioStreamFlush(stream);
+                flushed = 1;
+            }
+        }
+        overview_add(o, done, block, have);
+    }
+
+    if (done[0] == o->count[0])
+    {
+        overview_save(o, total);
+    }
+
+done:
+    SDL_free(in);
+    SDL_free(block);
+    if (stream != NULL)
+    {
+        SDL_FreeAudioStream(stream);
+    }
+    if (src.chunk != NULL)
+    {
+        Mix_FreeChunk(src.chunk);
+    }
+    if (rw != NULL)
+    {
+        SDL_RWclose(rw);
+    }
+    return 1;
+}
+
+/* Map the sidecar of `path` or start building its overview in the background.
+ * `rate` is the mixer's output rate and `decimate` builds level 0. */
+static inline void overview_start(struct overview *o, const char *path, int rate, decimate_fn decimate)
+{
+    SDL_memset(o, 0, sizeof(*o));
+    SDL_strlcpy(o->path, path, sizeof(o->path));
+    o->rate = rate;
+    o->decimate = decimate;
+    atomic_init(&o->quit, 0);
+    atomic_init(&o->ready, 0);
+
+    struct stat st;
+    if (stat(path, &st) == 0)
+    {
+        o->source_size = st.st_size;
+        o->source_mtime = st.st_mtime;
+        if (overview_map(o) == 0)
+        {
+            return;
+        }
+    }
+    o->thread = SDL_CreateThread(overview_thread, "overview", o);
+}
+
+/* frames of the song the levels cover so far (acquire: the levels are valid) */
+static inline Sint64 overview_ready(struct overview *o)
+{
+    return atomic_load_explicit(&o->ready, memory_order_acquire);
+}
+
+/* coarsest level with at least `columns` buckets */
+static inline int overview_level(const struct overview *o, int columns)
+{
+    int k = 0;
+    while (k + 1 < o->levels && o->count[k + 1] >= columns)
+    {
+        k++;
+    }
+    return k;
+}
+
+/* Stops the worker after its current slice; a decode in progress is waited for. */
+static inline void overview_free(struct overview *o)
+{
+    atomic_store(&o->quit, 1);
+    if (o->thread != NULL)
+    {
+        SDL_WaitThread(o->thread, NULL);
+        o->thread = NULL;
+    }
+    if (o->map != NULL)
+    {
+        munmap(o->map, o->map_size);
+        o->map = NULL;
+    }
+    SDL_free(o->storage);
+    o->storage = NULL;
+    atomic_store(&o->ready, 0);
+}
+
+#endif /* OVERVIEW_H */
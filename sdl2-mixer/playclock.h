@@ -0,0 +1,128 @@
+/* Sample-accurate playback clock.
+ *
+ * The audio thread calls playclock_mixed() once per postmix block.  It
+ * stamps the block with its position in the song (in frames) and the
+ * SDL_GetPerformanceCounter() value of the moment it was mixed.  A block
+ * reaches the speaker about one device buffer after it is mixed: SDL asks
+ * for the next buffer when the previous one starts playing.  The length of
+ * the block is therefore used as the output latency estimate, plus any
+ * extra latency configured by the caller.
+ *
+ * Other threads read the clock with playclock_seconds() (what is audible
+ * right now) and playclock_audible() (when a stamped block will be heard).
+ * Seeks and pauses are requested from the UI thread and applied by the
+ * audio thread on its next block, so the position is only ever written by
+ * one thread.  The mixed position is published through a sequence lock.
+ */
+#ifndef PLAYCLOCK_H
+#define PLAYCLOCK_H
+
+#include <stdatomic.h>
+
+#include <SDL2/SDL.h>
+
+struct playclock
+{
+    int rate;            /* frames per second */
+    Uint64 freq;         /* SDL_GetPerformanceFrequency() */
+    Uint64 extra;        /* additional output latency, in counter ticks */
+
+    /* published by the audio thread under seq */
+    atomic_uint seq;
+    atomic_llong frame;  /* song position of the last mixed block */
+    atomic_ullong mixed; /* counter value when it was mixed */
+    atomic_int frames;   /* its length in frames */
+
+    /* requests from other threads */
+    atomic_llong seek;   /* frame to continue from, -1 if none */
+    atomic_int paused;
+
+    Sint64 next;         /* audio thread only: position of the next block */
+};
+
+static inline void playclock_init(struct playclock *c, int rate, int extra_ms)
+{
+    c->rate = rate;
+    c->freq = SDL_GetPerformanceFrequency();
+    c->extra = c->freq * extra_ms / 1000;
+    atomic_init(&c->seq, 0);
+    atomic_init(&c->frame, 0);
+    atomic_init(&c->mixed, SDL_GetPerformanceCounter());
+    atomic_init(&c->frames, 0);
+    atomic_init(&c->seek, -1);
+    atomic_init(&c->paused, 0);
+    c->next = 0;
+}
+
+/* Audio thread: account for a block of `frames` frames being mixed now.
+ * Returns the song position of its first frame and stores the mix time. */
+static inline Sint64 playclock_mixed(struct playclock *c, int frames, Uint64 *mixed)
+{
+    const Sint64 seek = atomic_exchange(&c->seek, -1);
+    if (seek >= 0)
+    {
+        c->next = seek;
+    }
+
+    const Sint64 frame = c->next;
+    *mixed = SDL_GetPerformanceCounter();
+    if (!atomic_load_explicit(&c->paused, memory_order_relaxed))
+    {
+        c->next += frames;
+    }
+
+    const unsigned seq = atomic_load_explicit(&c->seq, memory_order_relaxed);
+    atomic_store_explicit(&c->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&c->frame, frame, memory_order_relaxed);
+    atomic_store_explicit(&c->mixed, *mixed, memory_order_relaxed);
+    atomic_store_explicit(&c->frames, frames, memory_order_relaxed);
+    atomic_store_explicit(&c->seq, seq + 2, memory_order_release);
+
+    return frame;
+}
+
+/* counter value at which a block mixed at `mixed` (block_frames long) is heard */
+static inline Uint64 playclock_audible(const struct playclock *c, Uint64 mixed, int block_frames)
+{
+    return mixed + c->freq * block_frames / c->rate + c->extra;
+}
+
+/* song position, in seconds, of the audio coming out of the speaker now */
+static inline double playclock_seconds(struct playclock *c)
+{
+    Sint64 frame;
+    Uint64 mixed;
+    int frames;
+    unsigned seq;
+    do
+    {
+        seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        frame = atomic_load_explicit(&c->frame, memory_order_relaxed);
+        mixed = atomic_load_explicit(&c->mixed, memory_order_relaxed);
+        frames = atomic_load_explicit(&c->frames, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) || seq != atomic_load_explicit(&c->seq, memory_order_relaxed));
+
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const Uint64 audible = playclock_audible(c, mixed, frames);
+    double seconds = (double)frame / c->rate;
+    if (!atomic_load_explicit(&c->paused, memory_order_relaxed))
+    {
+        seconds += ((double)now - (double)audible) / c->freq;
+    }
+    return (seconds < 0.0) ? 0.0 : seconds;
+}
+
+/* UI thread: the song continues from `seconds` starting with the next block */
+static inline void playclock_seek(struct playclock *c, double seconds)
+{
+    atomic_store(&c->seek, (Sint64)(seconds * c->rate));
+}
+
+static inline void playclock_pause(struct playclock *c, int paused)
+{
+    atomic_store(&c->paused, paused);
+}
+
+#endif /* PLAYCLOCK_H */
@@ -0,0 +1,165 @@
+/* Lock-free single-producer/single-consumer ring of audio blocks.
+ *
+ * The producer (the SDL_mixer postmix callback) fills the slot returned by
+ * ring_write_begin() and publishes it with ring_write_commit(); it never
+ * blocks and never waits for the consumer.  When every slot is still owned
+ * by the consumer the block is counted as an overrun and discarded.
+ *
+ * The consumer (the render loop) looks at the oldest block with ring_peek()
+ * and the ones behind it with ring_peek_at(), hands a slot back with
+ * ring_pop() once it is done reading it, and passes over a block it will not
+ * draw with ring_skip(), which counts it as a drop.
+ *
+ * head and tail are free-running counters kept on separate cache lines so the
+ * two threads do not false-share.
+ */
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+
+#include <SDL2/SDL.h>
+
+#define RING_CACHE_LINE 64
+
+struct ring_block
+{
+    Sint16 *data; /* block_samples samples, interleaved */
+    int len;      /* number of valid samples in data */
+    Sint64 frame; /* song position of the first frame (see playclock.h) */
+    Uint64 mixed; /* SDL_GetPerformanceCounter() when it was mixed */
+};
+
+struct ring
+{
+    /* written by the producer */
+    _Alignas(RING_CACHE_LINE) atomic_uint head;
+    atomic_uint overruns;
+
+    /* written by the consumer */
+    _Alignas(RING_CACHE_LINE) atomic_uint tail;
+    atomic_uint drops;
+
+    /* constant after ring_init() */
+    _Alignas(RING_CACHE_LINE) unsigned mask;
+    int block_samples;
+    struct ring_block *blocks;
+    Sint16 *storage;
+};
+
+/* capacity must be a power of two. Returns 0 on success, -1 on failure. */
+static inline int ring_init(struct ring *r, unsigned capacity, int block_samples)
+{
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+    {
+        return SDL_SetError("ring capacity %u is not a power of two", capacity);
+    }
+
+    r->blocks = SDL_calloc(capacity, sizeof(*r->blocks));
+    r->storage = SDL_calloc((size_t)capacity * block_samples, sizeof(Sint16));
+    if (r->blocks == NULL || r->storage == NULL)
+    {
+        SDL_free(r->blocks);
+        SDL_free(r->storage);
+        return SDL_SetError("out of memory");
+    }
+
+    for (unsigned i = 0; i < capacity; i++)
+    {
+        r->blocks[i].data = r->storage + (size_t)i * block_samples;
+    }
+    r->mask = capacity - 1;
+    r->block_samples = block_samples;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->overruns, 0);
+    atomic_init(&r->drops, 0);
+    return 0;
+}
+
+static inline void ring_free(struct ring *r)
+{
+    SDL_free(r->blocks);
+    SDL_free(r->storage);
+    r->blocks = NULL;
+    r->storage = NULL;
+}
+
+/* Producer: next free slot, or NULL (and an overrun) if the ring is full. */
+static inline struct ring_block *ring_write_begin(struct ring *r)
+{
+    const unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail > r->mask)
+    {
+        atomic_fetch_add_explicit(&r->overruns, 1, memory_order_relaxed);
+        return NULL;
+    }
+    return &r->blocks[head & r->mask];
+}
+
+/* Producer: publish the slot returned by ring_write_begin(). */
+static inline void ring_write_commit(struct ring *r)
+{
+    const unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
+
+/* Producer: number of free slots. */
+static inline unsigned ring_space(struct ring *r)
+{
+    const unsigned head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    const unsigned tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    return r->mask + 1 - (head - tail);
+}
+
+/* Consumer: number of blocks ready to be read. */
+static inline unsigned ring_count(struct ring *r)
+{
+    return atomic_load_explicit(&r->head, memory_order_acquire) -
+           atomic_load_explicit(&r->tail, memory_order_relaxed);
+}
+
+/* Consumer: oldest unread block, or NULL if the ring is empty. */
+static inline struct ring_block *ring_peek(struct ring *r)
+{
+    const unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (atomic_load_explicit(&r->head, memory_order_acquire) == tail)
+    {
+        return NULL;
+    }
+    return &r->blocks[tail & r->mask];
+}
+
+/* Consumer: the i-th oldest unread block (0 is ring_peek()), or NULL. */
+static inline struct ring_block *ring_peek_at(struct ring *r, unsigned i)
+{
+    const unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (atomic_load_explicit(&r->head, memory_order_acquire) - tail <= i)
+    {
+        return NULL;
+    }
+    return &r->blocks[(tail + i) & r->mask];
+}
+
+/* Consumer: release the block returned by ring_peek(). */
+static inline void ring_pop(struct ring *r)
+{
+    const unsigned tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+}
+
+/* Consumer: release the oldest block unread, counting it as a drop. */
+static inline void ring_skip(struct ring *r)
+{
+    atomic_fetch_add_explicit(&r->drops, 1, memory_order_relaxed);
+    ring_pop(r);
+}
+
+/* Total number of blocks ever committed by the producer. */
+static inline unsigned ring_produced(struct ring *r)
+{
+    return atomic_load_explicit(&r->head, memory_order_relaxed);
+}
+
+#endif /* RING_H */
@@ -3,33 +3,145 @@
 #include <SDL2/SDL_mixer.h>
 
 #include <stdarg.h>
+#include <getopt.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "decimate.h"
+#include "fft.h"
+#include "overview.h"
+#include "playclock.h"
+#include "ring.h"
 
 /* the lower it is, the more FPS shown and CPU needed */
 #define BUFFER 1024
-/* NEVER make W less than BUFFER! */
+/* range for -b, and where -b auto starts */
+#define MIN_BUFFER 256
+#define MAX_BUFFER 8192
 #define W 640
 #define H 480
 #define H2 (H / 2)
 #define H4 (H / 4)
 #define Y(sample) (((sample)*H) / 4 / 0x7fff)
 
-// used in postmix, refresh
-int stream_buffer_index = 0;
-Sint16 stream_buffers[2][BUFFER * 2 * 2];
-int need_refresh = 0;
+/* audio blocks in flight between postmix and the render loop: the audio ring
+ * also holds every block mixed but not yet audible (see next_block()), so it
+ * is sized from the latency and this is the headroom on top */
+#define RING_BLOCKS 16
+/* largest audio ring, in blocks of BLOCK_SAMPLES; -l beyond it is refused */
+#define RING_MAX_BLOCKS 1024
+/* interleaved stereo samples per block, enough for any buffer size */
+#define BLOCK_SAMPLES (MAX_BUFFER * 2)
+
+/* a callback this much later than one buffer after the previous one means
+ * the device ran dry; -b auto doubles the buffer when a TUNE_WINDOW_MS
+ * window sees TUNE_UNDERRUNS of them */
+#define LATE_CALLBACK 1.5
+#define WARMUP_CALLBACKS 8
+#define TUNE_WINDOW_MS 2000
+#define TUNE_UNDERRUNS 2
+
+/* -o: height of the whole-track overview strip above the live view */
+#define STRIP_H 48
+
+/* longest the main loop sleeps without an event, to notice the song ending */
+#define WAIT_MS 100
+
+// used in postmix, main loop
+struct ring audio_ring;
+Uint32 block_event = (Uint32)-1; /* SDL user event: a block is ready to draw */
+atomic_int wake_pending;         /* a block_event is already queued */
+Uint32 track_event = (Uint32)-1; /* SDL user event: the song has finished */
+
+/* -p: every file is a track.  The next one is read into memory and opened on
+ * a loader thread while the current one plays, so the switch in the main
+ * loop is a Mix_PlayMusic() on music that is ready to go. */
+struct track
+{
+    const char *filename;
+    SDL_Thread *loader; /* running load_track(), NULL once joined */
+    void *data;         /* file contents, read by music */
+    Mix_Music *music;
+    double load_ms;     /* time spent reading and opening the file */
+    char error[128];
+    struct overview overview; /* started once the track plays, with -o */
+};
+atomic_ullong finished_at; /* SDL_GetPerformanceCounter() when the song ended */
+int switches = 0;
+int stalls = 0;            /* switches that had to wait for the loader */
+double switch_ms_total = 0.0;
+double switch_ms_max = 0.0;
+
+/* --bench: headless run that draws every block as fast as it is decoded */
+int bench = 0;
+atomic_int music_finished;
+double *bench_frame_ms = NULL;
+int bench_frames = 0;
+int bench_capacity = 0;
+
+/* what refresh() shows; toggled in handle_keydown, read by postmix */
+enum view
+{
+    VIEW_WAVEFORM,
+    VIEW_SPECTRUM
+};
+atomic_int view = VIEW_WAVEFORM;
+
+/* spectrum analyzer: postmix feeds fft_ring, spectrum_thread transforms and
+ * hands dB magnitudes to refresh() through a triple buffer */
+#define FFT_SIZE 4096
+#define SPECTRUM_FRESH 4
+#define SPECTRUM_FLOOR_DB -96.0f
+#define SPECTRUM_MIN_HZ 20.0
+int fft_size = FFT_SIZE;
+struct ring fft_ring;
+SDL_sem *fft_sem = NULL;
+atomic_int fft_quit;
+float *spectrum_db[3];      /* fft_size / 2 + 1 values each */
+atomic_int spectrum_middle; /* last published buffer, | SPECTRUM_FRESH if unread */
+int spectrum_front = 0;     /* buffer owned by refresh() */
+int spectrum_bin[W + 1];    /* first FFT bin of each column */
 
-// used in postmix
-int sample_size = 0;
-int position = 0;
+// used in postmix, main loop, handle_keydown
+int sample_size = 0; /* bytes per frame */
+struct playclock play_clock;
+int extra_latency_ms = 0;
+int buffer_frames = BUFFER;
+atomic_uint underruns;
+Uint64 last_callback = 0;  /* audio thread only */
+int warmup_callbacks = 0;  /* audio thread only */
 
 // used in refresh
 Uint32 frame_count = 0;
+Uint64 frame_cpu_ns = 0;
+const struct decimate_kernel *decimate = NULL;
+struct envelope wave_env[W];
+
+/* how refresh() turns a buffer into pixels */
+enum render_mode
+{
+    RENDER_RECTS,   /* three SDL_RenderFillRect calls per sample (reference) */
+    RENDER_BATCH,   /* one clear plus one SDL_RenderFillRects per frame */
+    RENDER_TEXTURE, /* rasterize into a streaming texture, one copy per frame */
+    RENDER_MODES
+};
+const char *render_mode_names[RENDER_MODES] = {"rects", "batch", "texture"};
+int render_mode = RENDER_BATCH;
+SDL_Texture *wave_texture = NULL;
+SDL_Rect wave_rects[W * 2];
+
+/* -o: the playing track's overview, drawn above the live view */
+int show_overview = 0;
+struct overview *overview = NULL;
+SDL_Rect overview_rects[W];
+const SDL_Rect live_view = {0, STRIP_H, W, H};
 
-// used in handle_keydown
+// used in handle_keydown, spectrum_layout
 int audio_rate = 0;
 int volume = SDL_MIX_MAXVOLUME;
 
@@ -53,45 +165,369 @@ void cleanExit(char *str, ...)
     exit(1);
 }
 
+/* Blocks the audio ring needs at this rate and buffer size: a block is
+ * audible one device buffer plus extra_latency_ms after it is mixed, and the
+ * render loop keeps it until then.  Buffers only grow after this (-b auto),
+ * which makes blocks longer, so the count stays enough.  0 if it would take
+ * more than RING_MAX_BLOCKS. */
+static unsigned audio_ring_blocks(int rate, int frames)
+{
+    const Sint64 block = (Sint64)frames * 1000;
+    const Sint64 waiting = ((Sint64)extra_latency_ms * rate + block - 1) / block + 2;
+    unsigned blocks = 1;
+
+    while (blocks < waiting + RING_BLOCKS)
+    {
+        blocks *= 2;
+    }
+    return blocks <= RING_MAX_BLOCKS ? blocks : 0;
+}
+
+/* copy a mixer buffer into the next free block of r; 0 if r is full */
+static int push_block(struct ring *r, const Uint8 *stream, int len, Sint64 frame, Uint64 mixed)
+{
+    struct ring_block *block = ring_write_begin(r);
+    if (block == NULL)
+    {
+        // consumer is behind; counted as an overrun by the ring
+        return 0;
+    }
+
+    int n = len / (int)sizeof(Sint16);
+    if (n > r->block_samples)
+    {
+        n = r->block_samples;
+    }
+    memcpy(block->data, stream, n * sizeof(Sint16));
+    block->len = n;
+    block->frame = frame;
+    block->mixed = mixed;
+
+    ring_write_commit(r);
+    return 1;
+}
+
 static void postmix(void *udata, Uint8 *stream, int len)
 {
-    int w = *((int *)udata);
+    if (bench)
+    {
+        // The disk driver calls us as fast as we return, so wait for the
+        // renderer instead of dropping; nothing to draw once the song is over.
+        while (ring_space(&audio_ring) == 0 && !atomic_load(&music_finished))
+        {
+            SDL_Delay(0);
+        }
+        if (atomic_load(&music_finished))
+        {
+            return;
+        }
+    }
 
-    position += len / sample_size;
+    Uint64 mixed;
+    const Sint64 frame = playclock_mixed(&play_clock, len / sample_size, &mixed);
 
-    if (need_refresh)
+    if (warmup_callbacks > 0)
     {
-        return;
+        // the device fills its buffers back to back right after opening
+        warmup_callbacks--;
     }
+    else if (!bench && (double)(mixed - last_callback) * play_clock.rate >
+                           LATE_CALLBACK * play_clock.freq * (len / sample_size))
+    {
+        atomic_fetch_add(&underruns, 1);
+    }
+    last_callback = mixed;
 
-    stream_buffer_index = (stream_buffer_index + 1) % 2;
+    if (push_block(&audio_ring, stream, len, frame, mixed) && !atomic_exchange(&wake_pending, 1))
+    {
+        SDL_Event e;
+        SDL_zero(e);
+        e.type = block_event;
+        SDL_PushEvent(&e);
+    }
 
-    memcpy(stream_buffers[stream_buffer_index], stream,
-           (len > w * 4) ? w * 4 : len);
+    if (atomic_load_explicit(&view, memory_order_relaxed) == VIEW_SPECTRUM &&
+        push_block(&fft_ring, stream, len, frame, mixed))
+    {
+        SDL_SemPost(fft_sem);
+    }
+}
 
-    // indicate refresh() call required
-    need_refresh = 1;
+static void music_finished_hook(void)
+{
+    atomic_store(&finished_at, SDL_GetPerformanceCounter());
+    atomic_store(&music_finished, 1);
+
+    SDL_Event e;
+    SDL_zero(e);
+    e.type = track_event;
+    SDL_PushEvent(&e);
 }
 
-void refresh(SDL_Renderer *renderer)
+/* Loader thread: read the whole file, then let SDL_mixer open it from memory
+ * so that playing it touches neither the disk nor the decoder setup. */
+static int load_track(void *data)
 {
-    Sint16 *buf = stream_buffers[stream_buffer_index];
-    need_refresh = 0;
+    struct track *t = data;
+    const Uint64 start = SDL_GetPerformanceCounter();
 
-    for (int x = 0; x < W * 2; x++)
+    size_t size;
+    t->data = SDL_LoadFile(t->filename, &size);
+    if (t->data != NULL)
     {
-        const int X = x >> 1, b = x & 1, t = H4 + H2 * b;
-        int y1, h1;
-        if (buf[x] < 0)
+        t->music = Mix_LoadMUS_RW(SDL_RWFromConstMem(t->data, (int)size), 1);
+    }
+    if (t->music == NULL)
+    {
+        SDL_strlcpy(t->error, SDL_GetError(), sizeof(t->error));
+    }
+
+    t->load_ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    return t->music != NULL;
+}
+
+static void free_track(struct track *t)
+{
+    if (t->loader != NULL)
+    {
+        SDL_WaitThread(t->loader, NULL);
+        t->loader = NULL;
+    }
+    overview_free(&t->overview);
+    Mix_FreeMusic(t->music);
+    SDL_free(t->data);
+    t->music = NULL;
+    t->data = NULL;
+}
+
+static void preload_track(struct track *t)
+{
+    t->loader = SDL_CreateThread(load_track, "loader", t);
+    if (t->loader == NULL)
+    {
+        // no thread, load it now
+        load_track(t);
+    }
+}
+
+static void open_audio(int frames)
+{
+    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, frames) < 0)
+    {
+        cleanExit("Mix_OpenAudio(%d)", frames);
+    }
+
+    Mix_AllocateChannels(0);
+    buffer_frames = frames;
+    last_callback = 0;
+    warmup_callbacks = WARMUP_CALLBACKS;
+}
+
+/* Close and reopen the device with a new buffer size and carry on from the
+ * audible position.  The rate, format and channels do not change, so the
+ * loaded music stays valid. */
+static void reopen_audio(Mix_Music *music, int frames)
+{
+    const double pos = playclock_seconds(&play_clock);
+    const int paused = Mix_PausedMusic();
+
+    Mix_HookMusicFinished(NULL);
+    Mix_HaltMusic();
+    Mix_CloseAudio();
+    open_audio(frames);
+
+    Mix_SetPostMix(postmix, NULL);
+    Mix_HookMusicFinished(music_finished_hook);
+    if (Mix_PlayMusic(music, 1) == -1)
+    {
+        cleanExit("Mix_PlayMusic(0x%p,1)", music);
+    }
+    if (Mix_SetMusicPosition(pos) < 0)
+    {
+        printf("cannot seek this type of music, restarting it\n");
+        playclock_seek(&play_clock, 0.0);
+    }
+    else
+    {
+        playclock_seek(&play_clock, pos);
+    }
+    Mix_VolumeMusic(volume);
+    if (paused)
+    {
+        Mix_PauseMusic();
+    }
+}
+
+/* Start the first playable track after *current and preload the one after
+ * it.  Returns 0, leaving *current on the last track, when none is left. */
+static int play_next(struct track *tracks, int ntracks, int *current, FILE *info)
+{
+    for (int i = *current + 1; i < ntracks; i++)
+    {
+        struct track *t = &tracks[i];
+        const Uint64 wait_start = SDL_GetPerformanceCounter();
+        if (t->loader != NULL)
         {
-            h1 = -Y(buf[x]);
-            y1 = t - h1;
+            SDL_WaitThread(t->loader, NULL);
+            t->loader = NULL;
         }
-        else
+        const double wait_ms = (SDL_GetPerformanceCounter() - wait_start) * 1000.0 /
+                               SDL_GetPerformanceFrequency();
+        if (t->music == NULL)
+        {
+            fprintf(stderr, "Mix_LoadMUS(\"%s\"): %s, skipping\n", t->filename, t->error);
+            free_track(t);
+            continue;
+        }
+
+        playclock_seek(&play_clock, 0.0);
+        if (Mix_PlayMusic(t->music, 1) == -1)
         {
-            y1 = t;
-            h1 = Y(buf[x]);
+            cleanExit("Mix_PlayMusic(0x%p,1)", t->music);
         }
+        atomic_store(&music_finished, 0);
+
+        if (show_overview)
+        {
+            overview_start(&t->overview, t->filename, audio_rate, decimate->fn);
+            overview = &t->overview;
+            fprintf(info, "overview: %s\n", t->overview.cached ? "read from sidecar" : "building in the background");
+        }
+
+        if (*current >= 0)
+        {
+            const double switch_ms = (SDL_GetPerformanceCounter() - atomic_load(&finished_at)) *
+                                     1000.0 / SDL_GetPerformanceFrequency();
+            switches++;
+            switch_ms_total += switch_ms;
+            if (switch_ms > switch_ms_max)
+            {
+                switch_ms_max = switch_ms;
+            }
+            if (wait_ms >= 1.0)
+            {
+                stalls++;
+            }
+            fprintf(info, "track %d/%d %s: switched in %.2f ms (loaded in %.1f ms, waited %.1f ms)\n",
+                    i + 1, ntracks, t->filename, switch_ms, t->load_ms, wait_ms);
+            free_track(&tracks[*current]);
+        }
+
+        *current = i;
+        if (i + 1 < ntracks)
+        {
+            preload_track(&tracks[i + 1]);
+        }
+        return 1;
+    }
+
+    *current = ntracks - 1;
+    return 0;
+}
+
+/* Worker: keeps the last fft_size mono samples and publishes a spectrum
+ * whenever new blocks arrived, so neither the audio callback nor the render
+ * thread ever runs the transform. */
+static int spectrum_thread(void *data)
+{
+    struct fft *fft = data;
+    float *history = SDL_calloc(fft_size, sizeof(float));
+    float *power = SDL_malloc((fft_size / 2 + 1) * sizeof(float));
+    int back = 2;
+
+    while (history != NULL && power != NULL && !atomic_load(&fft_quit))
+    {
+        SDL_SemWaitTimeout(fft_sem, 100);
+
+        int fresh = 0;
+        struct ring_block *block;
+        while ((block = ring_peek(&fft_ring)) != NULL)
+        {
+            int frames = block->len / 2;
+            const Sint16 *src = block->data;
+            if (frames > fft_size)
+            {
+                src += 2 * (frames - fft_size);
+                frames = fft_size;
+            }
+            memmove(history, history + frames, (fft_size - frames) * sizeof(float));
+            float *dst = history + fft_size - frames;
+            for (int i = 0; i < frames; i++)
+            {
+                dst[i] = (src[2 * i] + src[2 * i + 1]) * (1.0f / 65536.0f);
+            }
+            ring_pop(&fft_ring);
+            fresh = 1;
+        }
+        if (!fresh)
+        {
+            continue;
+        }
+
+        fft_power(fft, history, power);
+        float *db = spectrum_db[back];
+        for (int k = 0; k <= fft_size / 2; k++)
+        {
+            db[k] = fft_db(fft, power[k]);
+        }
+        back = atomic_exchange(&spectrum_middle, back | SPECTRUM_FRESH) & 3;
+    }
+
+    SDL_free(history);
+    SDL_free(power);
+    return 0;
+}
+
+/* map columns to FFT bins on a log frequency axis from SPECTRUM_MIN_HZ to Nyquist */
+static void spectrum_layout(int rate)
+{
+    const double nyquist = rate / 2.0;
+    for (int x = 0; x <= W; x++)
+    {
+        const double hz = SPECTRUM_MIN_HZ * pow(nyquist / SPECTRUM_MIN_HZ, (double)x / W);
+        int bin = (int)(hz * fft_size / rate);
+        if (bin > fft_size / 2)
+        {
+            bin = fft_size / 2;
+        }
+        spectrum_bin[x] = bin;
+    }
+}
+
+/* CPU time consumed by the whole process (all threads), in nanoseconds */
+static Uint64 process_cpu_ns(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ((Uint64)ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000 +
+           ((Uint64)ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000;
+}
+
+/* CPU time consumed by the calling thread, in nanoseconds */
+static Uint64 thread_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (Uint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* vertical extent of column X, channel b (0: left on top, 1: right below),
+ * from the zero line out to the envelope's peaks */
+static void envelope_span(int X, int b, int *y, int *h)
+{
+    const int t = H4 + H2 * b;
+    const Sint16 mn = wave_env[X].min[b], mx = wave_env[X].max[b];
+    *y = t + Y(mn < 0 ? mn : 0);
+    *h = t + Y(mx > 0 ? mx : 0) - *y;
+}
+
+static void refresh_rects(SDL_Renderer *renderer)
+{
+    for (int x = 0; x < W * 2; x++)
+    {
+        const int X = x >> 1, b = x & 1;
+        int y1, h1;
+        envelope_span(X, b, &y1, &h1);
 
         SDL_Rect r;
 
@@ -118,9 +554,193 @@ void refresh(SDL_Renderer *renderer)
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255 /*a*/);
         SDL_RenderFillRect(renderer, &r);
     }
+}
+
+static void refresh_batch(SDL_Renderer *renderer)
+{
+    for (int x = 0; x < W * 2; x++)
+    {
+        SDL_Rect *r = &wave_rects[x];
+        r->x = x >> 1;
+        r->w = 1;
+        envelope_span(x >> 1, x & 1, &r->y, &r->h);
+    }
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255 /*a*/);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255 /*a*/);
+    SDL_RenderFillRects(renderer, wave_rects, W * 2);
+}
+
+static void refresh_texture(SDL_Renderer *renderer)
+{
+    if (wave_texture == NULL)
+    {
+        wave_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888,
+                                         SDL_TEXTUREACCESS_STREAMING, W, H);
+        if (wave_texture == NULL)
+        {
+            cleanExit("SDL_CreateTexture");
+        }
+    }
+
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(wave_texture, NULL, &pixels, &pitch) < 0)
+    {
+        cleanExit("SDL_LockTexture");
+    }
+
+    memset(pixels, 0, (size_t)pitch * H);
+    for (int x = 0; x < W * 2; x++)
+    {
+        int y1, h1;
+        envelope_span(x >> 1, x & 1, &y1, &h1);
+
+        Uint32 *p = (Uint32 *)((Uint8 *)pixels + (size_t)y1 * pitch) + (x >> 1);
+        for (int y = 0; y < h1; y++)
+        {
+            *p = 0xFFFFFFFF;
+            p = (Uint32 *)((Uint8 *)p + pitch);
+        }
+    }
+
+    SDL_UnlockTexture(wave_texture);
+    SDL_RenderCopy(renderer, wave_texture, NULL, NULL);
+}
+
+static void refresh_spectrum(SDL_Renderer *renderer)
+{
+    if (atomic_load(&spectrum_middle) & SPECTRUM_FRESH)
+    {
+        spectrum_front = atomic_exchange(&spectrum_middle, spectrum_front) & 3;
+    }
+    const float *db = spectrum_db[spectrum_front];
+
+    for (int x = 0; x < W; x++)
+    {
+        const int first = spectrum_bin[x];
+        const int last = (spectrum_bin[x + 1] > first) ? spectrum_bin[x + 1] : first + 1;
+        float peak = SPECTRUM_FLOOR_DB;
+        for (int k = first; k < last && k <= fft_size / 2; k++)
+        {
+            if (db[k] > peak)
+            {
+                peak = db[k];
+            }
+        }
+
+        SDL_Rect *r = &wave_rects[x];
+        r->x = x;
+        r->w = 1;
+        r->h = (int)((1.0f - peak / SPECTRUM_FLOOR_DB) * H);
+        if (r->h > H)
+        {
+            r->h = H;
+        }
+        r->y = H - r->h;
+    }
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255 /*a*/);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255 /*a*/);
+    SDL_RenderFillRects(renderer, wave_rects, W);
+}
+
+/* whole-track strip: as much of the song as the pyramid covers so far, and
+ * the playhead */
+static void refresh_overview(SDL_Renderer *renderer)
+{
+    struct overview *o = overview;
+    const SDL_Rect strip = {0, 0, W, STRIP_H};
+
+    SDL_RenderSetViewport(renderer, NULL);
+    SDL_SetRenderDrawColor(renderer, 32, 32, 32, 255 /*a*/);
+    SDL_RenderFillRect(renderer, &strip);
+
+    const Sint64 ready = overview_ready(o);
+    if (ready == 0)
+    {
+        return;
+    }
+
+    const int k = overview_level(o, W);
+    const Sint64 count = o->count[k];
+    const Sint64 valid = (ready == o->frames) ? count : ready / ((Sint64)OVERVIEW_BASE << k);
+    int n = 0;
+    for (int x = 0; x < W; x++)
+    {
+        Sint64 j = x * count / W, end = (x + 1) * count / W;
+        if (end <= j)
+        {
+            end = j + 1;
+        }
+        if (end > valid)
+        {
+            break;
+        }
+
+        int lo = 0x7fff, hi = -0x8000;
+        for (; j < end; j++)
+        {
+            const struct envelope *e = &o->level[k][j];
+            lo = SDL_min(lo, SDL_min(e->min[0], e->min[1]));
+            hi = SDL_max(hi, SDL_max(e->max[0], e->max[1]));
+        }
+        SDL_Rect *r = &overview_rects[n++];
+        r->x = x;
+        r->y = STRIP_H / 2 - hi * (STRIP_H / 2) / 0x8000;
+        r->w = 1;
+        r->h = (hi - lo) * (STRIP_H / 2) / 0x8000 + 1;
+    }
+    SDL_SetRenderDrawColor(renderer, 128, 128, 160, 255 /*a*/);
+    SDL_RenderFillRects(renderer, overview_rects, n);
+
+    const int x = (int)(playclock_seconds(&play_clock) * audio_rate * W / o->frames);
+    SDL_SetRenderDrawColor(renderer, 255, 64, 64, 255 /*a*/);
+    SDL_RenderDrawLine(renderer, x, 0, x, STRIP_H - 1);
+}
+
+void refresh(SDL_Renderer *renderer, const Sint16 *buf, int len)
+{
+    const Uint64 cpu_start = thread_cpu_ns();
+
+    if (overview != NULL)
+    {
+        // live view below the strip; SDL_RenderClear still clears both
+        SDL_RenderSetViewport(renderer, &live_view);
+    }
+
+    if (atomic_load(&view) == VIEW_SPECTRUM)
+    {
+        refresh_spectrum(renderer);
+    }
+    else
+    {
+        decimate->fn(buf, len / 2, W, wave_env);
+
+        switch (render_mode)
+        {
+        case RENDER_RECTS:
+            refresh_rects(renderer);
+            break;
+        case RENDER_TEXTURE:
+            refresh_texture(renderer);
+            break;
+        default:
+            refresh_batch(renderer);
+            break;
+        }
+    }
+
+    if (overview != NULL)
+    {
+        refresh_overview(renderer);
+    }
 
     SDL_RenderPresent(renderer);
 
+    frame_cpu_ns += thread_cpu_ns() - cpu_start;
     frame_count++;
 }
 
@@ -137,29 +757,33 @@ int handle_keydown(SDL_Keysym keysym)
         if (keysym.mod & KMOD_SHIFT)
         {
             Mix_RewindMusic();
-            position = 0;
+            playclock_seek(&play_clock, 0.0);
         }
         else
         {
-            int pos = position / audio_rate - 1;
-            if (pos < 0)
-                pos = 0;
+            double pos = playclock_seconds(&play_clock) - 1.0;
+            if (pos < 0.0)
+                pos = 0.0;
             Mix_SetMusicPosition(pos);
-            position = pos * audio_rate;
+            playclock_seek(&play_clock, pos);
         }
         break;
     case SDLK_RIGHT: // Right: Forward
         switch (Mix_GetMusicType(NULL))
         {
         case MUS_MP3:
+            // relative for MP3
             Mix_SetMusicPosition(+5);
-            position += 5 * audio_rate;
+            playclock_seek(&play_clock, playclock_seconds(&play_clock) + 5.0);
             break;
         case MUS_OGG:
         case MUS_FLAC:
-            Mix_SetMusicPosition(position / audio_rate + 1);
-            position += audio_rate;
+        {
+            const double pos = playclock_seconds(&play_clock) + 1.0;
+            Mix_SetMusicPosition(pos);
+            playclock_seek(&play_clock, pos);
             break;
+        }
         default:
             printf("cannot fast-forward this type of music\n");
             break;
@@ -177,14 +801,19 @@ int handle_keydown(SDL_Keysym keysym)
         volume >>= 1;
         Mix_VolumeMusic(volume);
         break;
+    case SDLK_s: // S: waveform / spectrum
+        atomic_store(&view, (atomic_load(&view) == VIEW_SPECTRUM) ? VIEW_WAVEFORM : VIEW_SPECTRUM);
+        break;
     case SDLK_SPACE: // Space: pause
         if (Mix_PausedMusic())
         {
             Mix_ResumeMusic();
+            playclock_pause(&play_clock, 0);
         }
         else
         {
             Mix_PauseMusic();
+            playclock_pause(&play_clock, 1);
         }
         break;
     }
@@ -192,8 +821,196 @@ int handle_keydown(SDL_Keysym keysym)
     return done;
 }
 
+/* The block to draw now, or NULL with *wait_ms set to when the next one is
+ * due.  A block is due once its audio is audible; when a newer block is
+ * already audible too the older one is skipped unless consume_all is set.
+ * Bench mode draws blocks as soon as they are mixed. */
+static struct ring_block *next_block(int consume_all, int *wait_ms)
+{
+    *wait_ms = WAIT_MS;
+    if (bench)
+    {
+        return ring_peek(&audio_ring);
+    }
+
+    const Uint64 now = SDL_GetPerformanceCounter();
+    struct ring_block *block;
+    while ((block = ring_peek(&audio_ring)) != NULL)
+    {
+        const Uint64 audible = playclock_audible(&play_clock, block->mixed, block->len / 2);
+        if (audible > now)
+        {
+            *wait_ms = (int)((audible - now) * 1000 / play_clock.freq) + 1;
+            return NULL;
+        }
+
+        struct ring_block *next = ring_peek_at(&audio_ring, 1);
+        if (consume_all || next == NULL ||
+            playclock_audible(&play_clock, next->mixed, next->len / 2) > now)
+        {
+            return block;
+        }
+        ring_skip(&audio_ring);
+    }
+    return NULL;
+}
+
+static void bench_record(double frame_ms)
+{
+    if (bench_frames == bench_capacity)
+    {
+        bench_capacity = bench_capacity ? bench_capacity * 2 : 4096;
+        bench_frame_ms = SDL_realloc(bench_frame_ms, bench_capacity * sizeof(double));
+        if (bench_frame_ms == NULL)
+        {
+            cleanExit("SDL_realloc");
+        }
+    }
+    bench_frame_ms[bench_frames++] = frame_ms;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    const double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* nearest-rank percentile of a sorted array */
+static double percentile(const double *sorted, int n, double p)
+{
+    if (n == 0)
+    {
+        return 0.0;
+    }
+    int i = (int)ceil(p / 100.0 * n) - 1;
+    return sorted[i < 0 ? 0 : i];
+}
+
+static void json_string(const char *str)
+{
+    putchar('"');
+    for (; *str; str++)
+    {
+        if (*str == '"' || *str == '\\')
+        {
+            printf("\\%c", *str);
+        }
+        else if ((unsigned char)*str < 0x20)
+        {
+            printf("\\u%04x", *str);
+        }
+        else
+        {
+            putchar(*str);
+        }
+    }
+    putchar('"');
+}
+
 int main(int argc, char **argv)
 {
+    static const struct option long_options[] = {
+        {"bench", no_argument, NULL, 'B'},
+        {NULL, 0, NULL, 0}};
+
+    int opt, bad_args = 0, consume_all = 0, auto_buffer = 0, playlist = 0;
+    while ((opt = getopt_long(argc, argv, "ab:l:n:opr:", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            show_overview = 1;
+            break;
+        case 'p':
+            playlist = 1;
+            break;
+        case 'b':
+            if (strcmp(optarg, "auto") == 0)
+            {
+                auto_buffer = 1;
+                buffer_frames = MIN_BUFFER;
+                break;
+            }
+            buffer_frames = atoi(optarg);
+            if (buffer_frames < MIN_BUFFER || buffer_frames > MAX_BUFFER ||
+                (buffer_frames & (buffer_frames - 1)) != 0)
+            {
+                bad_args = 1;
+            }
+            break;
+        case 'l':
+            extra_latency_ms = atoi(optarg);
+            if (extra_latency_ms < 0)
+            {
+                bad_args = 1;
+            }
+            break;
+        case 'a':
+            consume_all = 1;
+            break;
+        case 'B':
+            bench = 1;
+            consume_all = 1;
+            break;
+        case 'n':
+            fft_size = atoi(optarg);
+            if (fft_size < 256 || fft_size > 65536 || (fft_size & (fft_size - 1)) != 0)
+            {
+                bad_args = 1;
+            }
+            break;
+        case 'r':
+            for (render_mode = 0; render_mode < RENDER_MODES; render_mode++)
+            {
+                if (strcmp(optarg, render_mode_names[render_mode]) == 0)
+                {
+                    break;
+                }
+            }
+            if (render_mode == RENDER_MODES)
+            {
+                bad_args = 1;
+            }
+            break;
+        default:
+            bad_args = 1;
+            break;
+        }
+    }
+
+    if (bad_args || (bench && auto_buffer) || argc - optind < 1 || (!playlist && argc - optind > 2))
+    {
+        fprintf(stderr, "Usage: %s [-a] [-b frames|auto] [-l ms] [-n fft_size] [-o] [-r rects|batch|texture] filename [full_screen]\n"
+                        "       %s -p [options] filename...\n"
+                        "       %s --bench [-p] [-b frames] [-n fft_size] [-r rects|batch|texture] filename...\n"
+                        "    filename is any music file supported by your SDL_mixer library\n"
+                        "    -a draws every audio block instead of skipping to the newest\n"
+                        "    -b sets the audio buffer, a power of two from %d to %d frames (default: %d);\n"
+                        "       auto starts at %d and doubles it while the device underruns\n"
+                        "    -l adds output latency beyond one device buffer, to line up the picture\n"
+                        "    -n sets the spectrum FFT size, a power of two from 256 to 65536 (default: %d)\n"
+                        "    -o shows an overview of the whole song above, cached in filename.ovw\n"
+                        "    -p plays every filename in turn, opening the next one in the background\n"
+                        "    -r selects how the waveform is drawn (default: batch)\n"
+                        "    --bench decodes and draws every block as fast as possible without a\n"
+                        "        display or sound card and prints frame timings as JSON\n"
+                        "    keys: S toggles waveform/spectrum\n",
+                *argv, *argv, *argv, MIN_BUFFER, MAX_BUFFER, BUFFER, MIN_BUFFER, FFT_SIZE);
+        return 1;
+    }
+    const char *filename = argv[optind];
+    const int ntracks = playlist ? argc - optind : 1;
+    const int full_screen = !playlist && argc - optind > 1;
+
+    if (bench)
+    {
+        // headless defaults; anything already set in the environment wins
+        setenv("SDL_VIDEODRIVER", "dummy", 0);
+        setenv("SDL_AUDIODRIVER", "disk", 0);
+        setenv("SDL_DISKAUDIOFILE", "/dev/null", 0);
+        setenv("SDL_DISKAUDIODELAY", "0", 0);
+    }
+
     /* initialize SDL for audio and video */
     if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO) < 0)
     {
@@ -202,25 +1019,15 @@ int main(int argc, char **argv)
 
     atexit(SDL_Quit);
 
-    if (argc < 2 || argc > 3)
-    {
-        fprintf(stderr, "Usage: %s filename [full_screen]\n"
-                        "    filename is any music file supported by your SDL_mixer library\n",
-                *argv);
-        return 1;
-    }
-
     SDL_Window *window = SDL_CreateWindow("sdlwave - SDL_mixer demo",
-                                          SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, W, H,
-                                          ((argc > 2) ? SDL_WINDOW_FULLSCREEN : 0));
+                                          SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                          W, H + (show_overview ? STRIP_H : 0),
+                                          ((full_screen && !bench) ? SDL_WINDOW_FULLSCREEN : 0));
     if (window == NULL)
     {
         cleanExit("SDL_CreateWindow");
     }
 
-    int window_w, window_h;
-    SDL_GetWindowSize(window, &window_w, &window_h);
-
     SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, 0);
     if (renderer == NULL)
     {
@@ -229,44 +1036,134 @@ int main(int argc, char **argv)
 
     SDL_ShowCursor(SDL_DISABLE);
 
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, BUFFER) < 0)
+    if (ring_init(&fft_ring, RING_BLOCKS, BLOCK_SAMPLES) < 0)
     {
-        cleanExit("Mix_OpenAudio");
+        cleanExit("ring_init");
     }
 
-    Mix_AllocateChannels(0);
+    struct fft fft;
+    if (fft_init(&fft, fft_size) < 0)
+    {
+        cleanExit("fft_init(%d)", fft_size);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        spectrum_db[i] = SDL_malloc((fft_size / 2 + 1) * sizeof(float));
+        if (spectrum_db[i] == NULL)
+        {
+            cleanExit("SDL_malloc");
+        }
+        for (int k = 0; k <= fft_size / 2; k++)
+        {
+            spectrum_db[i][k] = SPECTRUM_FLOOR_DB;
+        }
+    }
+    atomic_init(&spectrum_middle, 1);
+    atomic_init(&fft_quit, 0);
+    fft_sem = SDL_CreateSemaphore(0);
+    SDL_Thread *fft_thread = SDL_CreateThread(spectrum_thread, "spectrum", &fft);
+    if (fft_sem == NULL || fft_thread == NULL)
+    {
+        cleanExit("spectrum thread");
+    }
+
+    atomic_init(&underruns, 0);
+    open_audio(buffer_frames);
 
     int audio_channels;
     Uint16 audio_format;
     Mix_QuerySpec(&audio_rate, &audio_format, &audio_channels);
     int bits = audio_format & 0xFF;
-    sample_size = bits / 8 + audio_channels;
-    printf("Opened audio at %d Hz %d bit %s, %d bytes audio buffer\n", audio_rate,
-           bits, audio_channels > 1 ? "stereo" : "mono", BUFFER);
+    sample_size = bits / 8 * audio_channels;
+    playclock_init(&play_clock, audio_rate, extra_latency_ms);
 
-    /* load the song */
-    Mix_Music *music = Mix_LoadMUS(argv[1]);
-    if (music == NULL)
+    // sized for the rate we got; postmix is not installed yet
+    const unsigned ring_blocks = audio_ring_blocks(audio_rate, buffer_frames);
+    if (ring_blocks == 0)
+    {
+        SDL_SetError("-l %d needs more than %d blocks of %d frames", extra_latency_ms,
+                     RING_MAX_BLOCKS, buffer_frames);
+        cleanExit("audio ring");
+    }
+    if (ring_init(&audio_ring, ring_blocks, BLOCK_SAMPLES) < 0)
     {
-        cleanExit("Mix_LoadMUS(\"%s\")", argv[1]);
+        cleanExit("ring_init");
     }
+    // keep stdout clean for the JSON report in bench mode
+    FILE *info = bench ? stderr : stdout;
+    fprintf(info, "Opened audio at %d Hz %d bit %s, %d frames audio buffer%s\n", audio_rate,
+            bits, audio_channels > 1 ? "stereo" : "mono", buffer_frames,
+            auto_buffer ? " (auto)" : "");
+
+    spectrum_layout(audio_rate);
 
-    Mix_SetPostMix(postmix, &window_w);
+    decimate = decimate_select();
+    fprintf(info, "Using %s waveform decimation\n", decimate->name);
 
+    /* load the song, or the first song of the playlist */
+    struct track *tracks = SDL_calloc(ntracks, sizeof(*tracks));
+    if (tracks == NULL)
+    {
+        cleanExit("SDL_calloc");
+    }
+    for (int i = 0; i < ntracks; i++)
+    {
+        tracks[i].filename = argv[optind + i];
+    }
+    load_track(&tracks[0]);
+
+    block_event = SDL_RegisterEvents(2);
+    if (block_event == (Uint32)-1)
+    {
+        cleanExit("SDL_RegisterEvents");
+    }
+    track_event = block_event + 1;
+    atomic_init(&wake_pending, 0);
+    atomic_init(&music_finished, 0);
+    atomic_init(&finished_at, 0);
+    Mix_SetPostMix(postmix, NULL);
+    Mix_HookMusicFinished(music_finished_hook);
+
+    const Uint64 cpu_ns = process_cpu_ns();
     Uint32 elapsed_ms = SDL_GetTicks();
-    if (Mix_PlayMusic(music, 1) == -1)
+    int track = -1;
+    if (!play_next(tracks, ntracks, &track, info))
     {
-        cleanExit("Mix_PlayMusic(0x%p,1)", music);
+        cleanExit("no playable track");
     }
 
     Mix_VolumeMusic(volume);
 
+    Uint32 tune_start = SDL_GetTicks();
+    unsigned tune_underruns = 0;
+
+    // in bench mode postmix may be waiting on us with the audio lock held,
+    // so the loop must not call into SDL_mixer
     int done = 0;
-    while ((Mix_PlayingMusic() || Mix_PausedMusic()) && !done)
+    // a finished song with tracks left is waiting for its track_event
+    while (!done && ((atomic_load(&music_finished) && track + 1 < ntracks) ||
+                     (bench ? !atomic_load(&music_finished) || ring_count(&audio_ring) > 0
+                            : Mix_PlayingMusic() || Mix_PausedMusic())))
     {
+        // sleep until a block is due or arrives, input arrives or WAIT_MS passes
+        int wait_ms;
+        struct ring_block *block = next_block(consume_all, &wait_ms);
         SDL_Event e;
-        while (SDL_PollEvent(&e))
+        int have_event = SDL_WaitEventTimeout(&e, block ? 0 : wait_ms);
+        for (; have_event; have_event = SDL_PollEvent(&e))
         {
+            if (e.type == block_event)
+            {
+                atomic_store(&wake_pending, 0);
+                continue;
+            }
+            if (e.type == track_event)
+            {
+                // postmix no longer waits for us, so SDL_mixer is safe to call
+                play_next(tracks, ntracks, &track, info);
+                continue;
+            }
+
             switch (e.type)
             {
             case SDL_KEYDOWN:
@@ -280,22 +1177,112 @@ int main(int argc, char **argv)
             }
         }
 
-        if (need_refresh)
+        if (auto_buffer && SDL_GetTicks() - tune_start >= TUNE_WINDOW_MS)
         {
-            refresh(renderer);
+            const unsigned total = atomic_load(&underruns);
+            if (total - tune_underruns >= TUNE_UNDERRUNS && buffer_frames < MAX_BUFFER)
+            {
+                printf("%u underruns at %d frames, growing audio buffer to %d\n",
+                       total - tune_underruns, buffer_frames, buffer_frames * 2);
+                reopen_audio(tracks[track].music, buffer_frames * 2);
+            }
+            tune_start = SDL_GetTicks();
+            tune_underruns = total;
         }
 
-        SDL_Delay(0);
+        if (block != NULL)
+        {
+            const Uint64 frame_start = SDL_GetPerformanceCounter();
+            refresh(renderer, block->data, block->len);
+            ring_pop(&audio_ring);
+            if (bench)
+            {
+                bench_record((SDL_GetPerformanceCounter() - frame_start) * 1000.0 /
+                             SDL_GetPerformanceFrequency());
+            }
+        }
     }
 
     elapsed_ms = SDL_GetTicks() - elapsed_ms;
+    const double cpu_ms_per_s = (process_cpu_ns() - cpu_ns) / 1e6 / (elapsed_ms / 1000.0);
+
+    const char *video_driver = SDL_GetCurrentVideoDriver();
+    const char *audio_driver = SDL_GetCurrentAudioDriver();
+    char drivers[128];
+    SDL_snprintf(drivers, sizeof(drivers), "%s/%s", video_driver ? video_driver : "none",
+                 audio_driver ? audio_driver : "none");
+
+    // let a waiting bench postmix go before stopping the song
+    atomic_store(&music_finished, 1);
+    Mix_HookMusicFinished(NULL);
+    Mix_HaltMusic();
+    for (int i = 0; i < ntracks; i++)
+    {
+        free_track(&tracks[i]);
+    }
+    SDL_free(tracks);
 
-    Mix_FreeMusic(music);
-    
     Mix_CloseAudio();
+
+    atomic_store(&fft_quit, 1);
+    SDL_SemPost(fft_sem);
+    SDL_WaitThread(fft_thread, NULL);
+    SDL_DestroySemaphore(fft_sem);
+    fft_free(&fft);
+
+    if (wave_texture != NULL)
+    {
+        SDL_DestroyTexture(wave_texture);
+    }
     SDL_Quit();
 
-    printf("fps=%.2f\n", ((float)frame_count) / (elapsed_ms / 1000.0));
+    if (bench)
+    {
+        const unsigned overruns = atomic_load(&audio_ring.overruns);
+        const unsigned drops = atomic_load(&audio_ring.drops);
+        qsort(bench_frame_ms, bench_frames, sizeof(double), compare_double);
+        printf("{\"file\": ");
+        json_string(filename);
+        printf(", \"drivers\": ");
+        json_string(drivers);
+        printf(", \"render\": \"%s\", \"decimate\": \"%s\",\n", render_mode_names[render_mode],
+               decimate->name);
+        printf(" \"frames\": %d, \"seconds\": %.3f, \"blocks_per_sec\": %.1f,"
+               " \"cpu_ms_per_s\": %.1f,\n",
+               bench_frames, elapsed_ms / 1000.0, bench_frames / (elapsed_ms / 1000.0), cpu_ms_per_s);
+        printf(" \"frame_ms\": {\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+               percentile(bench_frame_ms, bench_frames, 50), percentile(bench_frame_ms, bench_frames, 95),
+               percentile(bench_frame_ms, bench_frames, 99),
+               bench_frames ? bench_frame_ms[bench_frames - 1] : 0.0);
+        printf(" \"tracks\": %d, \"switches\": %d, \"switch_ms\": {\"avg\": %.3f, \"max\": %.3f},"
+               " \"stalls\": %d,\n",
+               ntracks, switches, switches ? switch_ms_total / switches : 0.0, switch_ms_max, stalls);
+        printf(" \"buffer_frames\": %d, \"blocks\": %u, \"overruns\": %u, \"dropped\": %u}\n",
+               buffer_frames, ring_produced(&audio_ring), overruns, drops);
+        SDL_free(bench_frame_ms);
+    }
+    else
+    {
+        printf("fps=%.2f cpu/frame=%.3fms cpu=%.1fms/s render=%s\n",
+               ((float)frame_count) / (elapsed_ms / 1000.0),
+               frame_count ? frame_cpu_ns / 1e6 / frame_count : 0.0, cpu_ms_per_s,
+               render_mode_names[render_mode]);
+        printf("blocks=%u overruns=%u dropped=%u\n", ring_produced(&audio_ring),
+               atomic_load(&audio_ring.overruns), atomic_load(&audio_ring.drops));
+        printf("buffer=%d frames%s underruns=%u\n", buffer_frames, auto_buffer ? " (auto)" : "",
+               atomic_load(&underruns));
+        if (playlist)
+        {
+            printf("tracks=%d switches=%d switch avg=%.2fms max=%.2fms stalls=%d\n", ntracks,
+                   switches, switches ? switch_ms_total / switches : 0.0, switch_ms_max, stalls);
+        }
+    }
+    ring_free(&audio_ring);
+    ring_free(&fft_ring);
+    for (int i = 0; i < 3; i++)
+    {
+        SDL_free(spectrum_db[i]);
+    }
 
     return 0;
 }
\ No newline at end of file
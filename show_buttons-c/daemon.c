@@ -0,0 +1,466 @@
+#define _GNU_SOURCE // accept4, pipe2
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+
+struct daemon
+{
+    char *socket_path;
+    int listen_fd;
+    int stop_pipe[2]; // readable once daemon_stop() has been called
+    _Bool bound;
+
+    daemon_prepare_fn prepare;
+    daemon_release_fn release;
+    Uint32 wake_event;
+
+    // queue[head] is the oldest request; the first `ready` of `count` have been prepared
+    SDL_mutex *lock;
+    SDL_cond *cond;
+    struct daemon_request *queue[DAEMON_QUEUE];
+    int head;
+    int count;
+    int ready;
+    _Bool stopping;
+
+    SDL_Thread *socket_thread;
+    SDL_Thread *prefetch_thread;
+};
+
+Sint64 daemon_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (Sint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void wake(struct daemon *d)
+{
+    SDL_Event event;
+
+    SDL_zero(event);
+    event.type = d->wake_event;
+    SDL_PushEvent(&event);
+}
+
+static void reply(int fd, const char *text)
+{
+    // a client that hung up must not take the daemon down with SIGPIPE
+    send(fd, text, strlen(text), MSG_NOSIGNAL);
+}
+
+static void free_request(struct daemon *d, struct daemon_request *r)
+{
+    if (r->prepared != NULL)
+    {
+        d->release(r);
+    }
+    free(r->file);
+    free(r);
+}
+
+static void handle_line(struct daemon *d, int fd, char *line)
+{
+    char text[64];
+    int ms = 0, angle = 0, n = 0;
+
+    const size_t len = strlen(line);
+    if (len > 0 && line[len - 1] == '\r')
+    {
+        line[len - 1] = '\0';
+    }
+    if (*line == '\0')
+    {
+        return;
+    }
+
+    struct daemon_request *r = calloc(1, sizeof(*r));
+    if (r == NULL)
+    {
+        reply(fd, "error out of memory\n");
+        return;
+    }
+
+    if (strcmp(line, "quit") == 0)
+    {
+        r->quit = true;
+    }
+    else if (sscanf(line, "show %d %d %n", &ms, &angle, &n) == 2 && line[n] != '\0')
+    {
+        // same limits as the command line
+        if (ms <= 0 || angle < 0 || angle > 359)
+        {
+            reply(fd, "error ms must be > 0 and angle 0..359\n");
+            free(r);
+            return;
+        }
+        r->ms = ms;
+        r->angle = angle;
+        r->file = strdup(line + n);
+        if (r->file == NULL)
+        {
+            reply(fd, "error out of memory\n");
+            free(r);
+            return;
+        }
+    }
+    else
+    {
+        reply(fd, "error usage: show <ms> <angle> <image file> | quit\n");
+        free(r);
+        return;
+    }
+    r->queued_ns = daemon_now_ns();
+
+    SDL_LockMutex(d->lock);
+    const int ahead = d->count;
+    if (ahead < DAEMON_QUEUE)
+    {
+        d->queue[(d->head + d->count) % DAEMON_QUEUE] = r;
+        d->count++;
+        SDL_CondSignal(d->cond);
+    }
+    SDL_UnlockMutex(d->lock);
+
+    if (ahead == DAEMON_QUEUE)
+    {
+        reply(fd, "error queue full\n");
+        free_request(d, r);
+        return;
+    }
+    wake(d);
+
+    snprintf(text, sizeof(text), "ok %d\n", ahead);
+    reply(fd, text);
+}
+
+static void serve_client(struct daemon *d, int fd)
+{
+    char buf[4096 + 64];
+    size_t len = 0;
+
+    for (;;)
+    {
+        struct pollfd fds[2] = {{fd, POLLIN, 0}, {d->stop_pipe[0], POLLIN, 0}};
+
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents != 0)
+        {
+            return;
+        }
+
+        const ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+        if (n <= 0)
+        {
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        len += n;
+        buf[len] = '\0';
+
+        char *line = buf, *newline;
+        while ((newline = strchr(line, '\n')) != NULL)
+        {
+            *newline = '\0';
+            handle_line(d, fd, line);
+            line = newline + 1;
+        }
+        len -= line - buf;
+        memmove(buf, line, len);
+
+        if (len == sizeof(buf) - 1)
+        {
+            reply(fd, "error line too long\n");
+            return;
+        }
+    }
+}
+
+static int socket_thread(void *data)
+{
+    struct daemon *d = data;
+
+    for (;;)
+    {
+        struct pollfd fds[2] = {{d->listen_fd, POLLIN, 0}, {d->stop_pipe[0], POLLIN, 0}};
+
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents != 0)
+        {
+            break;
+        }
+
+        const int fd = accept4(d->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+        serve_client(d, fd);
+        close(fd);
+    }
+
+    return 0;
+}
+
+static int prefetch_thread(void *data)
+{
+    struct daemon *d = data;
+
+    SDL_LockMutex(d->lock);
+    while (!d->stopping)
+    {
+        if (d->ready == d->count || d->ready >= DAEMON_PREFETCH)
+        {
+            SDL_CondWait(d->cond, d->lock);
+            continue;
+        }
+
+        // only this thread advances `ready`, and daemon_next() only takes ready requests, so r stays put
+        struct daemon_request *r = d->queue[(d->head + d->ready) % DAEMON_QUEUE];
+        SDL_UnlockMutex(d->lock);
+
+        if (!r->quit)
+        {
+            const Sint64 start = daemon_now_ns();
+            if (d->prepare(r) != 0)
+            {
+                snprintf(r->error, sizeof(r->error), "%s", SDL_GetError());
+            }
+            r->prepare_ms = (daemon_now_ns() - start) / 1e6;
+        }
+
+        SDL_LockMutex(d->lock);
+        d->ready++;
+        wake(d);
+    }
+    SDL_UnlockMutex(d->lock);
+
+    return 0;
+}
+
+struct daemon *daemon_start(const char *socket_path, daemon_prepare_fn prepare, daemon_release_fn release,
+                            Uint32 wake_event)
+{
+    struct sockaddr_un addr;
+
+    struct daemon *d = calloc(1, sizeof(*d));
+    if (d == NULL)
+    {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+    d->listen_fd = d->stop_pipe[0] = d->stop_pipe[1] = -1;
+    d->prepare = prepare;
+    d->release = release;
+    d->wake_event = wake_event;
+
+    SDL_zero(addr);
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+    {
+        SDL_SetError("socket path too long: %s", socket_path);
+        goto fail;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    d->socket_path = strdup(socket_path);
+    if (d->socket_path == NULL)
+    {
+        SDL_OutOfMemory();
+        goto fail;
+    }
+
+    if (pipe2(d->stop_pipe, O_CLOEXEC) < 0)
+    {
+        SDL_SetError("pipe2: %s", strerror(errno));
+        goto fail;
+    }
+
+    d->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (d->listen_fd < 0)
+    {
+        SDL_SetError("socket: %s", strerror(errno));
+        goto fail;
+    }
+
+    // a socket left behind by an earlier run would make bind() fail; anything else at that path is not ours to remove
+    struct stat st;
+    if (lstat(socket_path, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            SDL_SetError("\"%s\" exists and is not a socket", socket_path);
+            goto fail;
+        }
+        // only nobody listening makes it stale: a live one belongs to a daemon that is still running
+        const int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const int connected = probe >= 0 ? connect(probe, (struct sockaddr *)&addr, sizeof(addr)) : -1;
+        const int connect_errno = errno;
+        if (probe >= 0)
+        {
+            close(probe);
+        }
+        if (connected == 0 || connect_errno != ECONNREFUSED)
+        {
+            SDL_SetError("\"%s\": already running", socket_path);
+            goto fail;
+        }
+        unlink(socket_path);
+    }
+    if (bind(d->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        SDL_SetError("bind(\"%s\"): %s", socket_path, strerror(errno));
+        goto fail;
+    }
+    d->bound = true;
+
+    if (listen(d->listen_fd, 4) < 0)
+    {
+        SDL_SetError("listen: %s", strerror(errno));
+        goto fail;
+    }
+
+    d->lock = SDL_CreateMutex();
+    d->cond = SDL_CreateCond();
+    if (d->lock == NULL || d->cond == NULL)
+    {
+        goto fail;
+    }
+
+    d->prefetch_thread = SDL_CreateThread(prefetch_thread, "prefetch", d);
+    if (d->prefetch_thread == NULL)
+    {
+        goto fail;
+    }
+
+    d->socket_thread = SDL_CreateThread(socket_thread, "socket", d);
+    if (d->socket_thread == NULL)
+    {
+        goto fail;
+    }
+
+    return d;
+
+fail:
+    daemon_stop(d);
+    return NULL;
+}
+
+struct daemon_request *daemon_next(struct daemon *d)
+{
+    struct daemon_request *r = NULL;
+
+    SDL_LockMutex(d->lock);
+    if (d->ready > 0)
+    {
+        r = d->queue[d->head];
+        d->head = (d->head + 1) % DAEMON_QUEUE;
+        d->count--;
+        d->ready--;
+        // room to prefetch one more
+        SDL_CondSignal(d->cond);
+    }
+    SDL_UnlockMutex(d->lock);
+
+    return r;
+}
+
+void daemon_release(struct daemon *d, struct daemon_request *r)
+{
+    if (r != NULL)
+    {
+        free_request(d, r);
+    }
+}
+
+void daemon_stop(struct daemon *d)
+{
+    if (d == NULL)
+    {
+        return;
+    }
+
+    if (d->lock != NULL)
+    {
+        SDL_LockMutex(d->lock);
+        d->stopping = true;
+        if (d->cond != NULL)
+        {
+            SDL_CondSignal(d->cond);
+        }
+        SDL_UnlockMutex(d->lock);
+    }
+    if (d->stop_pipe[1] >= 0)
+    {
+        // never read, so it stays readable for every poll()
+        (void)!write(d->stop_pipe[1], "", 1);
+    }
+
+    if (d->socket_thread != NULL)
+    {
+        SDL_WaitThread(d->socket_thread, NULL);
+    }
+    if (d->prefetch_thread != NULL)
+    {
+        SDL_WaitThread(d->prefetch_thread, NULL);
+    }
+
+    for (int i = 0; i < d->count; i++)
+    {
+        free_request(d, d->queue[(d->head + i) % DAEMON_QUEUE]);
+    }
+
+    if (d->listen_fd >= 0)
+    {
+        close(d->listen_fd);
+    }
+    if (d->bound)
+    {
+        unlink(d->socket_path);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        if (d->stop_pipe[i] >= 0)
+        {
+            close(d->stop_pipe[i]);
+        }
+    }
+    if (d->cond != NULL)
+    {
+        SDL_DestroyCond(d->cond);
+    }
+    if (d->lock != NULL)
+    {
+        SDL_DestroyMutex(d->lock);
+    }
+    free(d->socket_path);
+    free(d);
+}
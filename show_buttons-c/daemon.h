@@ -0,0 +1,60 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * Resident mode: commands over a UNIX domain socket.
+ *
+ * A client connects to the stream socket and sends one command per line:
+ *
+ *     show <ms> <angle> <image file>
+ *     quit
+ *
+ * Each line is answered with "ok <requests ahead of it>" or "error <reason>".
+ * Clients are served one at a time.  Commands are queued, up to DAEMON_QUEUE
+ * deep, and taken in order; quit takes effect when it reaches the front.
+ *
+ * A prefetch thread runs the prepare callback on queued requests, at most
+ * DAEMON_PREFETCH ahead of the render thread, so the next image is decoded
+ * while the current one is on screen.  The render thread only ever gets
+ * requests that are ready.  Whenever a request is queued or becomes ready,
+ * wake_event is pushed, so a render loop idling in SDL_WaitEventTimeout()
+ * looks again.
+ */
+#define DAEMON_QUEUE 16
+#define DAEMON_PREFETCH 2
+
+struct daemon_request
+{
+    char *file;
+    int ms;
+    int angle;
+    _Bool quit;
+
+    Sint64 queued_ns; // daemon_now_ns() when the command arrived
+    double prepare_ms;
+    void *prepared; // set by the prepare callback
+    char error[256]; // SDL_GetError() if the prepare callback failed
+};
+
+/* return 0 on success, -1 (see SDL_GetError()) on failure; called on the prefetch thread */
+typedef int (*daemon_prepare_fn)(struct daemon_request *request);
+/* frees request->prepared, if set */
+typedef void (*daemon_release_fn)(struct daemon_request *request);
+
+struct daemon;
+
+/* returns NULL (see SDL_GetError()) if the socket or the threads cannot be set up */
+struct daemon *daemon_start(const char *socket_path, daemon_prepare_fn prepare, daemon_release_fn release,
+                            Uint32 wake_event);
+/* the oldest request if it is ready, else NULL; hand it back with daemon_release() */
+struct daemon_request *daemon_next(struct daemon *daemon);
+void daemon_release(struct daemon *daemon, struct daemon_request *request);
+/* closes and removes the socket, and drops requests still queued */
+void daemon_stop(struct daemon *daemon);
+
+/* CLOCK_MONOTONIC, the clock queued_ns is on */
+Sint64 daemon_now_ns(void);
+
+#endif /* DAEMON_H */
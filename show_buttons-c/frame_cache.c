@@ -0,0 +1,196 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frame_cache.h"
+
+#define FRAME_CACHE_MAGIC "SBFC"
+#define FRAME_CACHE_VERSION 1
+// pixels start on their own page, so the mapping hands out aligned rows
+#define FRAME_CACHE_DATA_OFFSET 4096
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+struct frame_cache_header
+{
+    char magic[4];
+    Uint32 version;
+    struct frame_cache_key key;
+    Sint32 pitch;
+    Uint32 data_offset;
+};
+
+static const char *cache_dir(void)
+{
+    const char *dir = getenv("SHOW_BUTTONS_CACHE");
+
+    if (dir == NULL)
+    {
+        return FRAME_CACHE_DIR;
+    }
+    return *dir != '\0' ? dir : NULL;
+}
+
+const char *frame_cache_path(const struct frame_cache_key *key, char *path, size_t size)
+{
+    const char *dir = cache_dir();
+
+    if (dir == NULL)
+    {
+        return NULL;
+    }
+    snprintf(path, size, "%s/%016llx-%dx%d-%d-%d-%08x.raw", dir, (unsigned long long)key->content, key->width,
+             key->height, key->angle, key->safe_permille, key->format);
+    return path;
+}
+
+int frame_cache_key(const char *image_file, int width, int height, int angle, float safe_area,
+                    Uint32 format, struct frame_cache_key *key)
+{
+    struct stat st;
+    Uint64 h = FNV_OFFSET;
+
+    const int fd = open(image_file, O_RDONLY);
+    if (fd < 0)
+    {
+        return SDL_SetError("open(\"%s\"): %s", image_file, strerror(errno));
+    }
+    if (fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return SDL_SetError("fstat(\"%s\"): %s", image_file, strerror(errno));
+    }
+    if (st.st_size > 0)
+    {
+        const unsigned char *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            close(fd);
+            return SDL_SetError("mmap(\"%s\"): %s", image_file, strerror(errno));
+        }
+        for (off_t i = 0; i < st.st_size; i++)
+        {
+            h = (h ^ p[i]) * FNV_PRIME;
+        }
+        munmap((void *)p, st.st_size);
+    }
+    close(fd);
+
+    SDL_zerop(key);
+    key->content = h;
+    key->width = width;
+    key->height = height;
+    key->angle = angle;
+    key->safe_permille = (int)(safe_area * 1000 + 0.5f);
+    key->format = format;
+    return 0;
+}
+
+// field by field: memcmp() would also compare the struct's padding, which assignment need not copy
+static _Bool key_equal(const struct frame_cache_key *a, const struct frame_cache_key *b)
+{
+    return a->content == b->content && a->width == b->width && a->height == b->height && a->angle == b->angle &&
+           a->safe_permille == b->safe_permille && a->format == b->format;
+}
+
+int frame_cache_open(const struct frame_cache_key *key, struct frame_cache_entry *entry)
+{
+    char path[4096];
+    struct stat st;
+
+    SDL_zerop(entry);
+    if (frame_cache_path(key, path, sizeof(path)) == NULL)
+    {
+        return -1;
+    }
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size < FRAME_CACHE_DATA_OFFSET)
+    {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    // the name says which frame it is; the header must agree, and the file must be whole
+    const struct frame_cache_header *header = map;
+    if (memcmp(header->magic, FRAME_CACHE_MAGIC, 4) != 0 || header->version != FRAME_CACHE_VERSION ||
+        !key_equal(&header->key, key) || header->data_offset != FRAME_CACHE_DATA_OFFSET ||
+        header->pitch < key->width * SDL_BYTESPERPIXEL(key->format) || header->pitch <= 0 ||
+        (size_t)st.st_size < FRAME_CACHE_DATA_OFFSET + (size_t)header->pitch * key->height)
+    {
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    entry->map = map;
+    entry->map_size = st.st_size;
+    entry->pixels = (const Uint8 *)map + FRAME_CACHE_DATA_OFFSET;
+    entry->width = key->width;
+    entry->height = key->height;
+    entry->pitch = header->pitch;
+    entry->format = key->format;
+    return 0;
+}
+
+void frame_cache_close(struct frame_cache_entry *entry)
+{
+    if (entry->map != NULL)
+    {
+        munmap(entry->map, entry->map_size);
+    }
+    SDL_zerop(entry);
+}
+
+int frame_cache_store(const struct frame_cache_key *key, const void *pixels, int pitch)
+{
+    char path[4096], tmp[4096 + 16];
+    struct frame_cache_header header;
+    static const char padding[FRAME_CACHE_DATA_OFFSET];
+    _Bool ok;
+
+    if (frame_cache_path(key, path, sizeof(path)) == NULL)
+    {
+        return 0;
+    }
+    mkdir(cache_dir(), 0755);
+
+    SDL_zero(header);
+    memcpy(header.magic, FRAME_CACHE_MAGIC, 4);
+    header.version = FRAME_CACHE_VERSION;
+    header.key = *key;
+    header.pitch = pitch;
+    header.data_offset = FRAME_CACHE_DATA_OFFSET;
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL)
+    {
+        return SDL_SetError("fopen(\"%s\"): %s", tmp, strerror(errno));
+    }
+    ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+         fwrite(padding, FRAME_CACHE_DATA_OFFSET - sizeof(header), 1, f) == 1 &&
+         fwrite(pixels, (size_t)pitch * key->height, 1, f) == 1;
+    if (fclose(f) != 0 || !ok || rename(tmp, path) != 0)
+    {
+        SDL_SetError("writing \"%s\": %s", path, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef FRAME_CACHE_H
+#define FRAME_CACHE_H
+
+#include <SDL2/SDL.h>
+
+/*
+ * On-disk cache of composed show_buttons frames.
+ *
+ * A frame is the whole screen as show_buttons first presents it: the image
+ * decoded, scaled into the safe area, rotated and centered on the bounding
+ * box.  It is stored raw, in the window's pixel format, behind a one page
+ * header, so a hit maps the file and hands the pixels to SDL_UpdateTexture()
+ * without decoding or scaling anything.
+ *
+ * The key is a hash of the image file's content plus everything the
+ * composition depends on: display size, rotation, safe area and pixel
+ * format.  Files are named after the key and written to a temporary name
+ * first, then renamed, so a reader never sees a partial frame.
+ *
+ * The directory is $SHOW_BUTTONS_CACHE, default FRAME_CACHE_DIR; an empty
+ * $SHOW_BUTTONS_CACHE disables the cache.
+ */
+#define FRAME_CACHE_DIR "/var/cache/show_buttons"
+
+struct frame_cache_key
+{
+    Uint64 content; // FNV-1a of the image file
+    int width;
+    int height;
+    int angle;
+    int safe_permille;
+    Uint32 format;
+};
+
+struct frame_cache_entry
+{
+    void *map;
+    size_t map_size;
+    const void *pixels; // inside map
+    int width;
+    int height;
+    int pitch;
+    Uint32 format;
+};
+
+/* returns 0 on success, -1 (see SDL_GetError()) if the image cannot be read */
+int frame_cache_key(const char *image_file, int width, int height, int angle, float safe_area,
+                    Uint32 format, struct frame_cache_key *key);
+/* returns 0 on a hit, -1 on a miss */
+int frame_cache_open(const struct frame_cache_key *key, struct frame_cache_entry *entry);
+void frame_cache_close(struct frame_cache_entry *entry);
+/* returns 0 on success, -1 (see SDL_GetError()) on failure */
+int frame_cache_store(const struct frame_cache_key *key, const void *pixels, int pitch);
+/* the file a key maps to, NULL if the cache is disabled */
+const char *frame_cache_path(const struct frame_cache_key *key, char *path, size_t size);
+
+#endif /* FRAME_CACHE_H */
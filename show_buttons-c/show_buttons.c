@@ -10,11 +10,22 @@
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_timer.h>
 
+#include "daemon.h"
+#include "frame_cache.h"
+#include "frame_pacer.h"
+
 char *image_file = NULL;
 int display_width = 0;
 int display_height = 0;
 int ms_to_display = 0;
 int rotation_angle = 0;
+char *socket_path = NULL;
+char *display_list = NULL; // "all", or display indexes separated by commas
+
+// Fraction of the display the image is scaled into.
+#define SAFE_AREA 0.90f
+// Windows in multi-display mode.
+#define MAX_SCREENS 8
 
 #define min(a, b) ((a) < (b) ? a : b)
 
@@ -96,9 +107,12 @@ void HSL_to_RGB(float h, float s, float l, int *red, int *green, int *blue)
     *blue = b * 255;
 }
 
+
 void usage()
 {
     puts("Usage: image_file width height ms_to_display rotation");
+    puts("       -m all|display[,display...] image_file ms_to_display rotation");
+    puts("       -d socket width height");
 }
 
 void free_args()
@@ -109,6 +123,18 @@ void free_args()
         image_file = NULL;
     }
 
+    if (socket_path != NULL)
+    {
+        free(socket_path);
+        socket_path = NULL;
+    }
+
+    if (display_list != NULL)
+    {
+        free(display_list);
+        display_list = NULL;
+    }
+
     display_width = 0;
     display_height = 0;
     ms_to_display = 0;
@@ -118,27 +144,66 @@ void free_args()
 int parse_args(int argc, char *argv[])
 {
     _Bool success = false;
+    int arg = 0;
 
-    if (argc != 6)
+    if (argc == 5 && strcmp(argv[1], "-d") == 0)
     {
-        goto done;
+        // Resident mode: images, times and angles come over the socket.
+        socket_path = strdup(argv[2]);
+        if (socket_path == NULL)
+        {
+            goto done;
+        }
+        arg = 3;
     }
+    else if (argc == 6 && strcmp(argv[1], "-m") == 0)
+    {
+        // Multi-display mode: each display's size comes from SDL.
+        if (strcmp(argv[2], "all") != 0 &&
+            (argv[2][0] == '\0' || strspn(argv[2], "0123456789,") != strlen(argv[2])))
+        {
+            goto done;
+        }
 
-    image_file = strdup(argv[1]);
-    if (image_file == NULL)
+        display_list = strdup(argv[2]);
+        image_file = strdup(argv[3]);
+        if (display_list == NULL || image_file == NULL)
+        {
+            goto done;
+        }
+    }
+    else if (argc == 6)
+    {
+        image_file = strdup(argv[1]);
+        if (image_file == NULL)
+        {
+            goto done;
+        }
+        arg = 2;
+    }
+    else
     {
         goto done;
     }
 
-    display_width = atoi(argv[2]);
-    if (display_width <= 0)
+    if (arg != 0)
     {
-        goto done;
+        display_width = atoi(argv[arg]);
+        if (display_width <= 0)
+        {
+            goto done;
+        }
+
+        display_height = atoi(argv[arg + 1]);
+        if (display_height <= 0)
+        {
+            goto done;
+        }
     }
 
-    display_height = atoi(argv[3]);
-    if (display_height <= 0)
+    if (socket_path != NULL)
     {
+        success = true;
         goto done;
     }
 
@@ -188,99 +253,844 @@ done:
     return ret;
 }
 
-int main(int argc, char *argv[])
+// Timer line colors, worked out once rather than every frame: the hue runs from 0 to 2/3 as time passes,
+// so the line starts red, turns green halfway and ends blue.
+#define TIMER_STEPS 256
+SDL_Color timer_colors[TIMER_STEPS + 1];
+
+void init_timer_colors()
+{
+    for (int i = 0; i <= TIMER_STEPS; i++)
+    {
+        int r, g, b;
+        HSL_to_RGB((float)i / TIMER_STEPS / 1.5f, 1.0f, 0.5f, &r, &g, &b);
+        timer_colors[i] = (SDL_Color){r, g, b, 255};
+    }
+}
+
+int timer_step(int elapsed_time, int total_time)
+{
+    if (elapsed_time >= total_time)
+    {
+        return TIMER_STEPS;
+    }
+    return (Sint64)elapsed_time * TIMER_STEPS / total_time;
+}
+
+// The first millisecond at which the timer has reached `step`.
+int timer_step_ms(int step, int total_time)
+{
+    return ((Sint64)step * total_time + TIMER_STEPS - 1) / TIMER_STEPS;
+}
+
+// Milliseconds until the step after this one, when the timer may next need drawing.
+int timer_wait_ms(int elapsed_time, int total_time)
+{
+    const int next = timer_step_ms(timer_step(elapsed_time, total_time) + 1, total_time);
+    return next > elapsed_time ? next - elapsed_time : 1;
+}
+
+// Whether the screen shows anything different at step `to` than at step `from`.
+_Bool timer_changed(int from, int to)
+{
+    return memcmp(&timer_colors[from], &timer_colors[to], sizeof(SDL_Color)) != 0;
+}
+
+// When the frame for `step` was due: the first millisecond after `shown` at which the line looked different.
+int timer_due_ms(int shown, int step, int total_time)
+{
+    int s = shown + 1;
+    while (s < step && !timer_changed(shown, s))
+    {
+        s++;
+    }
+    return timer_step_ms(s, total_time);
+}
+
+// A window covering one display, its renderer, and the scene composed for its size.
+struct screen
+{
+    int width;
+    int height;
+    Uint32 format; // the window's, which composed frames and the frame cache use
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    SDL_Texture *scene;
+};
+
+struct screen screens[MAX_SCREENS];
+int screen_count = 0;
+
+int open_screen(struct screen *screen, int x, int y, int width, int height)
 {
     _Bool success = false;
     int ret = 0;
-    float ratio = 0.0f;
-    _Bool running = false;
-    SDL_Window *window = NULL;
-    SDL_Renderer *renderer = NULL;
-    SDL_Surface *image_surface = NULL;
-    SDL_Texture *image_texture = NULL;
 
-    if (geteuid() != 0)
+    SDL_zerop(screen);
+    screen->width = width;
+    screen->height = height;
+
+    screen->window = SDL_CreateWindow("show_buttons", x, y, width, height, SDL_WINDOW_SHOWN);
+    HANDLE_SDL_ERROR(screen->window == NULL, "SDL_CreateWindow");
+
+    ret = SDL_SetWindowFullscreen(screen->window, SDL_WINDOW_FULLSCREEN);
+    HANDLE_SDL_ERROR(ret, "SDL_SetWindowFullscreen");
+
+    screen->renderer = SDL_CreateRenderer(screen->window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    HANDLE_SDL_ERROR(screen->renderer == NULL, "SDL_CreateRenderer");
+
+    // The cache holds the composed frame in the window's format, ready for SDL_UpdateTexture().
+    screen->format = SDL_GetWindowPixelFormat(screen->window);
+    if (screen->format == SDL_PIXELFORMAT_UNKNOWN)
     {
-        puts("Must be run as root.");
-        goto done;
+        screen->format = SDL_PIXELFORMAT_ARGB8888;
     }
 
-    success = parse_args(argc, argv);
-    if (!success)
+    success = true;
+
+done:
+    return success ? 0 : -1;
+}
+
+void close_screen(struct screen *screen)
+{
+    // Textures belong to the renderer, so before it goes.
+    if (screen->scene != NULL)
     {
-        goto done;
+        SDL_DestroyTexture(screen->scene);
     }
 
-    ret = SDL_Init(SDL_INIT_VIDEO);
-    HANDLE_SDL_ERROR(ret, "SDL_Init");
+    if (screen->renderer != NULL)
+    {
+        SDL_DestroyRenderer(screen->renderer);
+    }
 
-    const IMG_InitFlags init_flags = IMG_INIT_JPG | IMG_INIT_PNG;
-    ret = IMG_Init(init_flags);
-    HANDLE_SDL_ERROR((ret & init_flags) == 0, "IMG_Init");
+    if (screen->window != NULL)
+    {
+        SDL_DestroyWindow(screen->window);
+    }
+
+    SDL_zerop(screen);
+}
 
-    image_surface = IMG_Load(image_file);
-    if (image_surface == NULL)
+_Bool display_selected(int index)
+{
+    if (strcmp(display_list, "all") == 0)
     {
-        printf("IMG_Load: %s\n", IMG_GetError());
-        goto done;
+        return true;
     }
 
-    SDL_ShowCursor(SDL_DISABLE);
+    const char *p = display_list;
+    while (*p != '\0')
+    {
+        char *end;
+        const long int n = strtol(p, &end, 10);
+        if (end != p && n == index)
+        {
+            return true;
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return false;
+}
+
+// Opens a screen on each display in display_list, at that display's position and size.
+int open_displays()
+{
+    const int displays = SDL_GetNumVideoDisplays();
+    if (displays < 1)
+    {
+        printf("SDL_GetNumVideoDisplays: %s\n", SDL_GetError());
+        return -1;
+    }
 
-    window = SDL_CreateWindow("show_buttons", 0, 0, display_width, display_height, SDL_WINDOW_SHOWN);
-    HANDLE_SDL_ERROR(window == NULL, "SDL_CreateWindow");
+    for (int i = 0; i < displays && screen_count < MAX_SCREENS; i++)
+    {
+        SDL_Rect bounds;
+        float ddpi = 0.0f;
 
-    ret = SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN);
-    HANDLE_SDL_ERROR(ret, "SDL_SetWindowFullscreen");
+        if (!display_selected(i))
+        {
+            continue;
+        }
 
-    // Draw bounding box.
-    const float safearea_percent = 0.90f;
-    const int safe_width = display_width * safearea_percent;
-    const int safe_height = display_height * safearea_percent;
+        if (SDL_GetDisplayBounds(i, &bounds) != 0)
+        {
+            printf("SDL_GetDisplayBounds(%d): %s\n", i, SDL_GetError());
+            return -1;
+        }
+        SDL_GetDisplayDPI(i, &ddpi, NULL, NULL);
+        printf("display %d: %d x %d at %d, %d; %.0f dpi\n", i, bounds.w, bounds.h, bounds.x, bounds.y, ddpi);
+
+        if (open_screen(&screens[screen_count++], bounds.x, bounds.y, bounds.w, bounds.h) != 0)
+        {
+            return -1;
+        }
+    }
 
-    if (rotation_angle == 0 || rotation_angle == 180)
+    if (screen_count == 0)
     {
-        ratio = min((float)safe_width / image_surface->w, (float)safe_height / image_surface->h);
+        printf("no display matches %s\n", display_list);
+        return -1;
+    }
+
+    return 0;
+}
+
+// The whole frame: the composed scene, then the timer line along the bottom of the safe area.
+// The back buffer is undefined after a present, so nothing is left from the last frame.
+int draw_frame(struct screen *screen, int step)
+{
+    int ret = 0;
+    const int safe_width = screen->width * SAFE_AREA;
+    const int safe_height = screen->height * SAFE_AREA;
+    const SDL_Color color = timer_colors[step];
+
+    ret = SDL_RenderCopy(screen->renderer, screen->scene, NULL, NULL);
+    HANDLE_SDL_ERROR(ret, "SDL_RenderCopy");
+
+    const int x1 = (screen->width - safe_width) / 2;
+    const int y1 = screen->height - ((screen->height - safe_height) / 2) - 1;
+    ret = draw_rect(screen->renderer, x1, y1, safe_width, 1, color.r, color.g, color.b);
+
+done:
+    return ret;
+}
+
+// Where the image goes on a screen: scaled into the safe area, keeping its aspect ratio, and centered.
+SDL_Rect fit_image(const struct screen *screen, int width, int height, int angle, float *ratio)
+{
+    const int safe_width = screen->width * SAFE_AREA;
+    const int safe_height = screen->height * SAFE_AREA;
+
+    if (angle == 0 || angle == 180)
+    {
+        *ratio = min((float)safe_width / width, (float)safe_height / height);
     }
     else
     {
         // Assume 90 or 270 degree rotation.
-        ratio = min((float)safe_width / image_surface->h, (float)safe_height / image_surface->w);
+        *ratio = min((float)safe_width / height, (float)safe_height / width);
     }
 
-    printf("display: %d x %d; image: %d x %d; ratio: %.2f; angle: %d\n", display_width, display_height, image_surface->w, image_surface->h, ratio, rotation_angle);
-    printf("safe: %d x %d\n", safe_width, safe_height);
+    SDL_Rect dest;
+    dest.w = width * *ratio;
+    dest.h = height * *ratio;
+    if (dest.w < 1)
+    {
+        dest.w = 1;
+    }
+    if (dest.h < 1)
+    {
+        dest.h = 1;
+    }
+
+    // Center image
+    dest.x = (screen->width - dest.w) / 2;
+    dest.y = (screen->height - dest.h) / 2;
+
+    return dest;
+}
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    HANDLE_SDL_ERROR(renderer == NULL, "SDL_CreateRenderer");
+// A frame on its way to a screen: either cached, or the image decoded and waiting to be composed.
+struct image
+{
+    _Bool have_key;
+    struct frame_cache_key key;
+    struct frame_cache_entry cached; // map is set on a hit
+    SDL_Surface *surface;            // decoded on a miss; pre-scaled when there are several screens
+    int width;                       // of the image file
+    int height;
+};
+
+void free_image(struct image *image)
+{
+    frame_cache_close(&image->cached);
+
+    if (image->surface != NULL)
+    {
+        SDL_FreeSurface(image->surface);
+    }
+
+    SDL_zerop(image);
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 16)
+#define stretch_surface SDL_SoftStretchLinear
+#else
+// Nearest neighbour; bilinear arrived in 2.0.16.
+#define stretch_surface SDL_SoftStretch
+#endif
+
+struct scale_job
+{
+    SDL_Surface *source; // shared by every job, read only
+    SDL_Rect dest;
+    SDL_Surface *scaled;
+    char error[256];
+};
+
+int scale_thread(void *data)
+{
+    struct scale_job *job = data;
+
+    // A surface of its own over the shared pixels: SDL keeps blit state in the source surface.
+    SDL_Surface *source = SDL_CreateRGBSurfaceWithFormatFrom(job->source->pixels, job->source->w, job->source->h, 32,
+                                                             job->source->pitch, SDL_PIXELFORMAT_ARGB8888);
+    job->scaled = SDL_CreateRGBSurfaceWithFormat(0, job->dest.w, job->dest.h, 32, SDL_PIXELFORMAT_ARGB8888);
+
+    if (source == NULL || job->scaled == NULL || stretch_surface(source, NULL, job->scaled, NULL) != 0)
+    {
+        snprintf(job->error, sizeof(job->error), "%s", SDL_GetError());
+        if (job->scaled != NULL)
+        {
+            SDL_FreeSurface(job->scaled);
+            job->scaled = NULL;
+        }
+    }
+
+    if (source != NULL)
+    {
+        SDL_FreeSurface(source);
+    }
+
+    return 0;
+}
+
+// Everything up to the renderers, for each of count screens: hash, cache lookup, decode.
+// Makes no renderer calls, so resident mode runs it on the prefetch thread.  The image is
+// decoded once however many screens miss.  With one screen the GPU scales it for free; with
+// several, each screen that missed gets a copy pre-scaled to its size, on a thread of its own,
+// so no renderer uploads more than it shows.  Returns -1 (see SDL_GetError()) on failure.
+int prepare_image(const char *file, int angle, const struct screen *screens, struct image *images, int count)
+{
+    _Bool success = false;
+    struct frame_cache_key key;
+    struct scale_job jobs[MAX_SCREENS];
+    SDL_Thread *threads[MAX_SCREENS];
+    SDL_Surface *decoded = NULL;
+    int misses = 0;
+
+    const _Bool have_key = frame_cache_key(file, screens[0].width, screens[0].height, angle, SAFE_AREA,
+                                           screens[0].format, &key) == 0;
+    if (!have_key)
+    {
+        printf("frame_cache_key: %s\n", SDL_GetError());
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        struct image *image = &images[i];
+
+        SDL_zerop(image);
+        if (!have_key)
+        {
+            misses++;
+            continue;
+        }
+
+        // The content hash holds for every screen; the rest of the key is the screen's own.
+        image->have_key = true;
+        image->key = key;
+        image->key.width = screens[i].width;
+        image->key.height = screens[i].height;
+        image->key.format = screens[i].format;
+
+        if (frame_cache_open(&image->key, &image->cached) != 0)
+        {
+            misses++;
+            continue;
+        }
+
+        // Fault the frame in here rather than in SDL_UpdateTexture().
+        const volatile Uint8 *pixels = image->cached.map;
+        for (size_t j = 0; j < image->cached.map_size; j += 4096)
+        {
+            (void)pixels[j];
+        }
+    }
+
+    if (misses == 0)
+    {
+        return 0;
+    }
+
+    const IMG_InitFlags init_flags = IMG_INIT_JPG | IMG_INIT_PNG;
+    if ((IMG_Init(init_flags) & init_flags) == 0)
+    {
+        goto done;
+    }
+
+    SDL_Surface *surface = IMG_Load(file);
+    if (surface == NULL)
+    {
+        goto done;
+    }
+
+    // Convert here, not in SDL_CreateTextureFromSurface() on the render thread.
+    decoded = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(surface);
+    if (decoded == NULL)
+    {
+        goto done;
+    }
+
+    if (count == 1)
+    {
+        images[0].surface = decoded;
+        images[0].width = decoded->w;
+        images[0].height = decoded->h;
+        decoded = NULL;
+        success = true;
+        goto done;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        float ratio;
+
+        threads[i] = NULL;
+        if (images[i].cached.map != NULL)
+        {
+            continue;
+        }
+
+        SDL_zero(jobs[i]);
+        jobs[i].source = decoded;
+        jobs[i].dest = fit_image(&screens[i], decoded->w, decoded->h, angle, &ratio);
+
+        threads[i] = SDL_CreateThread(scale_thread, "scale", &jobs[i]);
+        if (threads[i] == NULL)
+        {
+            scale_thread(&jobs[i]);
+        }
+    }
+
+    success = true;
+    for (int i = 0; i < count; i++)
+    {
+        if (images[i].cached.map != NULL)
+        {
+            continue;
+        }
+
+        if (threads[i] != NULL)
+        {
+            SDL_WaitThread(threads[i], NULL);
+        }
 
-    image_texture = SDL_CreateTextureFromSurface(renderer, image_surface);
+        if (jobs[i].scaled == NULL)
+        {
+            SDL_SetError("scaling for screen %d: %s", i, jobs[i].error);
+            success = false;
+            continue;
+        }
+        images[i].surface = jobs[i].scaled;
+        images[i].width = decoded->w;
+        images[i].height = decoded->h;
+    }
+
+done:
+    if (decoded != NULL)
+    {
+        SDL_FreeSurface(decoded);
+    }
+
+    return success ? 0 : -1;
+}
+
+// Composes a prepared image and the bounding box into screen->scene, a full screen texture
+// the render loops copy every frame, and stores the frame on a cache miss.
+int compose_image(struct screen *screen, int angle, struct image *image)
+{
+    _Bool success = false;
+    _Bool target = false;
+    int ret = 0;
+    float ratio = 0.0f;
+    SDL_Renderer *renderer = screen->renderer;
+    SDL_Texture *image_texture = NULL;
+    SDL_Texture *scene_texture = NULL;
+    void *pixels = NULL;
+    char cache_file[4096];
+
+    const int safe_width = screen->width * SAFE_AREA;
+    const int safe_height = screen->height * SAFE_AREA;
+    const int pitch = screen->width * SDL_BYTESPERPIXEL(screen->format);
+    const SDL_Rect frame = {0, 0, screen->width, screen->height};
+
+    if (image->cached.map != NULL)
+    {
+        // The cached frame is the scene.
+        scene_texture = SDL_CreateTexture(renderer, image->cached.format, SDL_TEXTUREACCESS_STATIC,
+                                          image->cached.width, image->cached.height);
+        HANDLE_SDL_ERROR(scene_texture == NULL, "SDL_CreateTexture");
+
+        ret = SDL_UpdateTexture(scene_texture, NULL, image->cached.pixels, image->cached.pitch);
+        HANDLE_SDL_ERROR(ret, "SDL_UpdateTexture");
+
+        success = true;
+        goto done;
+    }
+
+    // Specify dest rect - SDL_RenderCopyEx will resize to fit, unless the surface is pre-scaled.
+    const SDL_Rect dest = fit_image(screen, image->width, image->height, angle, &ratio);
+
+    printf("display: %d x %d; image: %d x %d; ratio: %.2f; angle: %d\n", screen->width, screen->height, image->width, image->height, ratio, angle);
+    printf("safe: %d x %d\n", safe_width, safe_height);
+
+    image_texture = SDL_CreateTextureFromSurface(renderer, image->surface);
     HANDLE_SDL_ERROR(image_texture == NULL, "SDL_CreateTextureFromSurface");
 
+    // Compose into a render target texture.  Without render targets, compose in the
+    // back buffer and read it back into a static texture.
+    target = SDL_RenderTargetSupported(renderer);
+    if (target)
+    {
+        scene_texture = SDL_CreateTexture(renderer, screen->format, SDL_TEXTUREACCESS_TARGET, screen->width, screen->height);
+        HANDLE_SDL_ERROR(scene_texture == NULL, "SDL_CreateTexture");
+
+        ret = SDL_SetRenderTarget(renderer, scene_texture);
+        HANDLE_SDL_ERROR(ret, "SDL_SetRenderTarget");
+    }
+
+    // The draw color is still the previous image's timer in resident mode.
+    ret = SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    HANDLE_SDL_ERROR(ret, "SDL_SetRenderDrawColor");
+
     ret = SDL_RenderClear(renderer);
     HANDLE_SDL_ERROR(ret, "SDL_RenderClear");
 
     // Draw bounding box.
-    if (draw_rect(renderer, 0, 0, display_width, display_height, 0x10, 0x10, 0x10) != 0)
+    if (draw_rect(renderer, 0, 0, screen->width, screen->height, 0x10, 0x10, 0x10) != 0)
     {
         goto done;
     }
 
-    // Specify dest rect - SDL_RenderCopyEx will resize to fit.
-    SDL_Rect dest;
-    dest.w = image_surface->w * ratio;
-    dest.h = image_surface->h * ratio;
+    ret = SDL_RenderCopyEx(renderer, image_texture, NULL /*srcrect*/, &dest /*destrect*/, angle /*angle*/, NULL /*center*/, SDL_FLIP_NONE);
+    HANDLE_SDL_ERROR(ret, "SDL_RenderCopyEx(");
 
-    // Center image
-    dest.x = (display_width - dest.w) / 2;
-    dest.y = (display_height - dest.h) / 2;
+    const _Bool store = image->have_key && frame_cache_path(&image->key, cache_file, sizeof(cache_file)) != NULL;
+    if (store || !target)
+    {
+        pixels = malloc((size_t)pitch * screen->height);
+        if (pixels == NULL || SDL_RenderReadPixels(renderer, &frame, screen->format, pixels, pitch) != 0)
+        {
+            printf("SDL_RenderReadPixels: %s\n", pixels == NULL ? "out of memory" : SDL_GetError());
+            if (!target)
+            {
+                goto done;
+            }
+        }
+        else if (store && frame_cache_store(&image->key, pixels, pitch) != 0)
+        {
+            printf("frame cache: %s\n", SDL_GetError());
+        }
+    }
 
-    ret = SDL_RenderCopyEx(renderer, image_texture, NULL /*srcrect*/, &dest /*destrect*/, rotation_angle /*angle*/, NULL /*center*/, SDL_FLIP_NONE);
-    HANDLE_SDL_ERROR(ret, "SDL_RenderCopyEx(");
+    if (!target)
+    {
+        scene_texture = SDL_CreateTexture(renderer, screen->format, SDL_TEXTUREACCESS_STATIC, screen->width, screen->height);
+        HANDLE_SDL_ERROR(scene_texture == NULL, "SDL_CreateTexture");
 
-    SDL_RenderPresent(renderer);
+        ret = SDL_UpdateTexture(scene_texture, NULL, pixels, pitch);
+        HANDLE_SDL_ERROR(ret, "SDL_UpdateTexture");
+    }
 
-    const long int start_time = time_now();
+    success = true;
+
+done:
+    if (target)
+    {
+        SDL_SetRenderTarget(renderer, NULL);
+    }
+
+    free(pixels);
+
+    if (image_texture != NULL)
+    {
+        SDL_DestroyTexture(image_texture);
+    }
+
+    if (success)
+    {
+        if (screen->scene != NULL)
+        {
+            SDL_DestroyTexture(screen->scene);
+        }
+        screen->scene = scene_texture;
+    }
+    else if (scene_texture != NULL)
+    {
+        SDL_DestroyTexture(scene_texture);
+    }
+
+    return success ? 0 : -1;
+}
+
+int prepare_request(struct daemon_request *request)
+{
+    struct image *image = malloc(sizeof(*image));
+    if (image == NULL)
+    {
+        return SDL_OutOfMemory();
+    }
+
+    if (prepare_image(request->file, request->angle, &screens[0], image, 1) != 0)
+    {
+        free_image(image);
+        free(image);
+        return -1;
+    }
+
+    request->prepared = image;
+    return 0;
+}
+
+void release_request(struct daemon_request *request)
+{
+    free_image(request->prepared);
+    free(request->prepared);
+    request->prepared = NULL;
+}
+
+// Resident mode: the window and renderer stay up, and images come from commands on socket_path.
+// Switch latency runs from when an image could have gone on screen - when its command
+// arrived, or when the image before it was done, whichever is later - to its first present.
+int run_daemon(struct screen *screen, struct frame_pacer *pacer)
+{
+    _Bool success = false;
+    _Bool running = false;
+    struct daemon *daemon = NULL;
+    struct daemon_request *current = NULL;
+    int shown_step = 0;
+    Sint64 shown_ns = 0;
+    Sint64 due_ns = 0;
+
+    const Uint32 wake_event = SDL_RegisterEvents(1);
+    HANDLE_SDL_ERROR(wake_event == (Uint32)-1, "SDL_RegisterEvents");
+
+    // Load the codecs now rather than on the first uncached image.
+    const IMG_InitFlags init_flags = IMG_INIT_JPG | IMG_INIT_PNG;
+    HANDLE_SDL_ERROR((IMG_Init(init_flags) & init_flags) == 0, "IMG_Init");
+
+    daemon = daemon_start(socket_path, prepare_request, release_request, wake_event);
+    HANDLE_SDL_ERROR(daemon == NULL, "daemon_start");
+
+    printf("listening on %s\n", socket_path);
+    fflush(stdout);
+
+    running = true;
+
+    while (running)
+    {
+        SDL_Event event;
+
+        while (SDL_PollEvent(&event))
+        {
+            if (event.type == SDL_QUIT)
+            {
+                running = false;
+            }
+        }
+
+        const Sint64 now = daemon_now_ns();
+
+        if (current == NULL || now >= due_ns)
+        {
+            struct daemon_request *next = daemon_next(daemon);
+
+            if (next != NULL && next->quit)
+            {
+                daemon_release(daemon, next);
+                break;
+            }
+
+            if (next != NULL && next->prepared == NULL)
+            {
+                printf("%s: %s\n", next->file, next->error);
+                fflush(stdout);
+                daemon_release(daemon, next);
+                continue;
+            }
+
+            if (next != NULL)
+            {
+                struct image *image = next->prepared;
+                const _Bool cache_hit = image->cached.map != NULL;
+                const Sint64 wanted_ns = current != NULL && due_ns > next->queued_ns ? due_ns : next->queued_ns;
+
+                if (compose_image(screen, next->angle, image) != 0 || draw_frame(screen, 0) != 0)
+                {
+                    daemon_release(daemon, next);
+                    goto done;
+                }
+                // On the GPU now.
+                free_image(image);
+                shown_step = 0;
+
+                SDL_RenderPresent(screen->renderer);
+                shown_ns = daemon_now_ns();
+                // Due when this pass picked it up; waiting for the decode is in the switch latency.
+                frame_pacer_presented(pacer, now);
+
+                printf("switch: %s; frame cache %s; prepared in %.1f ms; latency %.1f ms\n", next->file,
+                       cache_hit ? "hit" : "miss", next->prepare_ms, (shown_ns - wanted_ns) / 1e6);
+                fflush(stdout);
+
+                daemon_release(daemon, current);
+                current = next;
+                due_ns = shown_ns + (Sint64)current->ms * 1000000;
+                continue;
+            }
+        }
+
+        // Nothing to draw yet: sleep until the timer changes or the present rate allows it,
+        // or SDL or the daemon threads push an event.
+        int wait_ms = 100;
+
+        if (current != NULL && now < due_ns)
+        {
+            const int elapsed_time = (now - shown_ns) / 1000000;
+            const int step = timer_step(elapsed_time, current->ms);
+            const int hold_ms = frame_pacer_hold_ms(pacer);
+
+            if (timer_changed(shown_step, step) && hold_ms == 0)
+            {
+                if (draw_frame(screen, step) != 0)
+                {
+                    goto done;
+                }
+
+                SDL_RenderPresent(screen->renderer);
+                frame_pacer_presented(pacer, shown_ns + (Sint64)timer_due_ms(shown_step, step, current->ms) * 1000000);
+                shown_step = step;
+                continue;
+            }
+
+            wait_ms = timer_changed(shown_step, step)
+                          ? hold_ms
+                          : min(timer_wait_ms(elapsed_time, current->ms), (int)((due_ns - now) / 1000000) + 1);
+        }
+
+        SDL_WaitEventTimeout(NULL, wait_ms);
+    }
+
+    success = true;
+
+done:
+    // The release callback is called through the daemon, so before it goes.
+    daemon_release(daemon, current);
+    daemon_stop(daemon);
+
+    return success ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    _Bool success = false;
+    int ret = 0;
+    _Bool running = false;
+    struct frame_pacer pacer = {0};
+    struct image images[MAX_SCREENS];
+    char cache_file[4096];
+    int shown_step = 0;
+    const long int launch_time = time_now();
+
+    SDL_zero(images);
+
+    if (geteuid() != 0)
+    {
+        puts("Must be run as root.");
+        goto done;
+    }
+
+    success = parse_args(argc, argv);
+    if (!success)
+    {
+        goto done;
+    }
+    success = false;
+
+    init_timer_colors();
+
+    ret = SDL_Init(SDL_INIT_VIDEO);
+    HANDLE_SDL_ERROR(ret, "SDL_Init");
+
+    SDL_ShowCursor(SDL_DISABLE);
+
+    if (display_list != NULL)
+    {
+        if (open_displays() != 0)
+        {
+            goto done;
+        }
+    }
+    else
+    {
+        screen_count = 1;
+        if (open_screen(&screens[0], 0, 0, display_width, display_height) != 0)
+        {
+            goto done;
+        }
+    }
+
+    // Paced by the first screen; the others present right after it.
+    {
+        SDL_RendererInfo renderer_info = {0};
+        SDL_DisplayMode display_mode = {0};
+        SDL_GetRendererInfo(screens[0].renderer, &renderer_info);
+        SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(screens[0].window), &display_mode);
+        frame_pacer_init(&pacer, display_mode.refresh_rate, (renderer_info.flags & SDL_RENDERER_PRESENTVSYNC) != 0);
+    }
+
+    if (socket_path != NULL)
+    {
+        printf("startup: %.1f ms\n", (time_now() - launch_time) / 1000.0);
+        success = run_daemon(&screens[0], &pacer) == 0;
+        goto done;
+    }
+
+    if (prepare_image(image_file, rotation_angle, screens, images, screen_count) != 0)
+    {
+        printf("%s: %s\n", image_file, SDL_GetError());
+        goto done;
+    }
+
+    for (int i = 0; i < screen_count; i++)
+    {
+        if (compose_image(&screens[i], rotation_angle, &images[i]) != 0 || draw_frame(&screens[i], 0) != 0)
+        {
+            goto done;
+        }
+    }
+
+    for (int i = 0; i < screen_count; i++)
+    {
+        SDL_RenderPresent(screens[i].renderer);
+    }
+
+    for (int i = 0; i < screen_count; i++)
+    {
+        if (images[i].have_key)
+        {
+            printf("frame cache %s: %s\n", images[i].cached.map != NULL ? "hit" : "miss",
+                   frame_cache_path(&images[i].key, cache_file, sizeof(cache_file)) ? cache_file : "disabled");
+        }
+
+        // The pixels are on the GPU now.
+        free_image(&images[i]);
+    }
+
+    if (screen_count > 1)
+    {
+        printf("startup: %.1f ms for %d displays\n", (time_now() - launch_time) / 1000.0, screen_count);
+    }
+    else
+    {
+        printf("startup: %.1f ms\n", (time_now() - launch_time) / 1000.0);
+    }
+
+    const Sint64 start_ns = frame_pacer_now();
 
     running = true;
 
@@ -302,48 +1112,52 @@ int main(int argc, char *argv[])
             }
         }
 
-        const int elapsed_time = timediff_ms(start_time);
+        const int elapsed_time = (frame_pacer_now() - start_ns) / 1000000;
         if (elapsed_time > ms_to_display)
         {
             break;
         }
 
-        // Draw timer.
+        // Present only when the timer line looks different, and at most once a refresh period;
+        // otherwise sleep until it may, waking early for input.
+        const int step = timer_step(elapsed_time, ms_to_display);
+        if (!timer_changed(shown_step, step))
         {
-            const float ratio = min((float)elapsed_time / ms_to_display, 1.0);
-
-            int r, g, b;
-            HSL_to_RGB(ratio / 1.5f, 1.0f, 0.5f, &r, &g, &b);
+            SDL_WaitEventTimeout(NULL, min(timer_wait_ms(elapsed_time, ms_to_display), ms_to_display - elapsed_time + 1));
+            continue;
+        }
+        const int hold_ms = frame_pacer_hold_ms(&pacer);
+        if (hold_ms > 0)
+        {
+            SDL_WaitEventTimeout(NULL, hold_ms);
+            continue;
+        }
 
-            const int x1 = (display_width - safe_width) / 2;
-            const int y1 = display_height - ((display_height - safe_height) / 2) - 1;
-            if (draw_rect(renderer, x1, y1, safe_width, 1, r, g, b) != 0)
+        for (int i = 0; i < screen_count; i++)
+        {
+            if (draw_frame(&screens[i], step) != 0)
             {
                 goto done;
             }
-
-            SDL_RenderPresent(renderer);
         }
 
-        SDL_Delay(1000 / 60);
+        for (int i = 0; i < screen_count; i++)
+        {
+            SDL_RenderPresent(screens[i].renderer);
+        }
+        frame_pacer_presented(&pacer, start_ns + (Sint64)timer_due_ms(shown_step, step, ms_to_display) * 1000000);
+        shown_step = step;
     }
 
     success = true;
 
 done:
-    if (renderer != NULL)
-    {
-        SDL_DestroyRenderer(renderer);
-    }
-
-    if (image_surface != NULL)
-    {
-        SDL_FreeSurface(image_surface);
-    }
+    frame_pacer_report(&pacer, stdout);
 
-    if (image_texture != NULL)
+    for (int i = 0; i < MAX_SCREENS; i++)
     {
-        SDL_DestroyTexture(image_texture);
+        free_image(&images[i]);
+        close_screen(&screens[i]);
     }
 
     if (SDL_WasInit(0))
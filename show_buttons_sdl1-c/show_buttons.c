@@ -24,6 +24,8 @@
 #include <SDL/SDL_image.h>
 #include <SDL/SDL_rotozoom.h>
 
+#include "frame_pacer.h"
+
 char *image_file = NULL;
 int display_width = 0;
 int display_height = 0;
@@ -199,6 +201,8 @@ int main(int argc, char *argv[])
     SDL_Surface *image_surface = NULL;
     SDL_Surface *rotozoom_surface = NULL;
     float ratio = 0.0;
+    int refresh_hz = 0;
+    struct frame_pacer pacer = {0};
 
     if (geteuid() != 0)
     {
@@ -233,7 +237,15 @@ int main(int argc, char *argv[])
 
     display_width = vinfo.xres;
     display_height = vinfo.yres;
-    printf("Using frame buffer %d x %d\n", display_width, display_height);
+
+    // SDL 1.2 cannot tell the refresh rate; the pixel clock (ps per pixel) and the blanking intervals can
+    if (vinfo.pixclock > 0)
+    {
+        const double htotal = vinfo.xres + vinfo.left_margin + vinfo.right_margin + vinfo.hsync_len;
+        const double vtotal = vinfo.yres + vinfo.upper_margin + vinfo.lower_margin + vinfo.vsync_len;
+        refresh_hz = 1e12 / (vinfo.pixclock * htotal * vtotal) + 0.5;
+    }
+    printf("Using frame buffer %d x %d at %d Hz\n", display_width, display_height, refresh_hz);
 #endif
 
     ret = SDL_Init(SDL_INIT_VIDEO);
@@ -303,6 +315,9 @@ int main(int argc, char *argv[])
     const long int start_time = time_now();
     _Bool running = true;
 
+    // SDL_Flip() of a software surface does not wait for the vertical blank
+    frame_pacer_init(&pacer, refresh_hz, 0);
+
     while (running)
     {
         SDL_Event event;
@@ -343,10 +358,12 @@ int main(int argc, char *argv[])
         // UpdateRect
         SDL_Flip(screen_surface);
 
-        SDL_Delay(1000 / 60);
+        frame_pacer_wait(&pacer);
     }
 
 done:
+    frame_pacer_report(&pacer, stdout);
+
     if (rotozoom_surface != NULL)
     {
         SDL_FreeSurface(rotozoom_surface);